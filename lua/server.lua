@@ -108,9 +108,102 @@ workspace "server"
 
 		includedirs {
 			"../src/test-client/",
+			"../src/server/",
 			"../deps/enet-1.3.17/include/",
 		}
 
 		files {
 			"../src/test-client/**",
+		}
+
+	project "stats-reader"
+		targetname "stats-reader"
+		language "c++"
+		cppdialect "c++17"
+		kind "consoleapp"
+		warnings "off"
+
+		pchheader "stdafx.hpp"
+		pchsource "../src/stats-reader/stdafx.cpp"
+		forceincludes "stdafx.hpp"
+
+		includedirs {
+			"../src/stats-reader/",
+			"../src/server/",
+		}
+
+		files {
+			"../src/stats-reader/**",
+		}
+
+	project "log-decoder"
+		targetname "log-decoder"
+		language "c++"
+		cppdialect "c++17"
+		kind "consoleapp"
+		warnings "off"
+
+		pchheader "stdafx.hpp"
+		pchsource "../src/log-decoder/stdafx.cpp"
+		forceincludes "stdafx.hpp"
+
+		includedirs {
+			"../src/log-decoder/",
+			"../src/server/",
+		}
+
+		files {
+			"../src/log-decoder/**",
+		}
+
+	project "net-proxy"
+		targetname "net-proxy"
+		language "c++"
+		cppdialect "c++17"
+		kind "consoleapp"
+		warnings "off"
+
+		pchheader "stdafx.hpp"
+		pchsource "../src/net-proxy/stdafx.cpp"
+		forceincludes "stdafx.hpp"
+
+		links {
+			"enet",
+			"ws2_32",
+			"winmm",
+		}
+
+		includedirs {
+			"../src/net-proxy/",
+			"../deps/enet-1.3.17/include/",
+		}
+
+		files {
+			"../src/net-proxy/**",
+		}
+
+	project "load-generator"
+		targetname "load-generator"
+		language "c++"
+		cppdialect "c++17"
+		kind "consoleapp"
+		warnings "off"
+
+		pchheader "stdafx.hpp"
+		pchsource "../src/load-generator/stdafx.cpp"
+		forceincludes "stdafx.hpp"
+
+		links {
+			"enet",
+			"ws2_32",
+			"winmm",
+		}
+
+		includedirs {
+			"../src/load-generator/",
+			"../deps/enet-1.3.17/include/",
+		}
+
+		files {
+			"../src/load-generator/**",
 		}
\ No newline at end of file
@@ -0,0 +1,503 @@
+using clock_type = std::chrono::steady_clock;
+
+// Every simulated player plays the same script: create or join its room, ready up once the room
+// is full, then die on cue until one survivor is granted the win, for as many matches as asked.
+// The survivor fires a powerup at a random player before every death but the last, and with -reconnect one
+// player per room drops and rejoins between matches
+enum class phase_t
+{
+	RECONNECTING,
+	CONNECTING,
+	JOINING,
+	LOBBY,
+	STARTING,
+	PLAYING,
+	DONE,
+};
+
+struct player_t
+{
+	ENetPeer* peer = nullptr;
+	int room = 0;
+	phase_t phase = phase_t::CONNECTING;
+
+	// Server time is local time plus offset, taken from the clock sync sample with the lowest RTT
+	double offset = 0.0;
+	double sync_rtt = 1e9;
+	int syncs = 0;
+	clock_type::time_point last_sync;
+	clock_type::time_point start_at;
+	clock_type::time_point left_at;
+	bool rejoining = false;
+	std::uint64_t packets = 0;
+	std::uint64_t bytes = 0;
+};
+
+struct room_t
+{
+	std::string id;
+	std::vector<int> players;
+	int joined = 0;
+	int matches = 0;
+	int next_death = 0;
+	int started = 0;
+	int reconnects = 0;
+	clock_type::time_point ready_at;
+	clock_type::time_point first_start;
+	clock_type::time_point started_at;
+	clock_type::time_point last_death;
+};
+
+struct totals_t
+{
+	std::uint64_t matches = 0;
+	double start_ms = 0.0;
+	double match_ms = 0.0;
+	double skew_ms = 0.0;
+	double skew_max_ms = 0.0;
+	std::uint64_t powerups = 0;
+	double powerup_ms = 0.0;
+	double powerup_max_ms = 0.0;
+	std::uint64_t reconnects = 0;
+	double reconnect_ms = 0.0;
+	double reconnect_max_ms = 0.0;
+};
+
+const auto epoch = clock_type::now();
+std::vector<player_t> players;
+std::vector<room_t> rooms;
+totals_t totals;
+
+// Send time of every powerup, the powerup number doubles as its index
+std::vector<clock_type::time_point> powerups_sent;
+bool aborted = false;
+
+void send(player_t& player, const std::string& message)
+{
+	enet_peer_send(player.peer, 0, enet_packet_create(message.c_str(), message.size() + 1, ENET_PACKET_FLAG_RELIABLE));
+}
+
+int read_proto(const char* data)
+{
+	return std::strncmp(data, "proto=", 6) ? -1 : std::atoi(data + 6);
+}
+
+// Value of a key=value field in a server message, or nullptr
+const char* find_field(const char* data, const char* key)
+{
+	auto length = std::strlen(key);
+
+	for (auto field = data; field; field = std::strchr(field, ';'))
+	{
+		field += *field == ';';
+
+		if (!std::strncmp(field, key, length) && field[length] == '=')
+		{
+			return field + length + 1;
+		}
+	}
+
+	return nullptr;
+}
+
+double to_ms(clock_type::time_point time)
+{
+	return std::chrono::duration<double, std::milli>(time - epoch).count();
+}
+
+void ready_up(room_t& room, clock_type::time_point now)
+{
+	room.ready_at = now;
+	room.next_death = 0;
+	room.started = 0;
+
+	for (auto index : room.players)
+	{
+		players[index].phase = phase_t::LOBBY;
+		send(players[index], "proto=2");
+	}
+}
+
+// A few samples a player, spaced out so one lost datagram cannot take them all. Replies are unreliable,
+// a sample that never comes back is simply asked for again
+void sync_clocks(clock_type::time_point now)
+{
+	for (auto& player : players)
+	{
+		if (player.phase == phase_t::CONNECTING || player.syncs >= 4 || now - player.last_sync < 100ms)
+		{
+			continue;
+		}
+
+		char message[64];
+		std::snprintf(message, sizeof(message), "proto=15;t0=%.3f", to_ms(now));
+		send(player, message);
+
+		player.last_sync = now;
+	}
+}
+
+// Players that reached their start time start playing and tell the server when they did. All of them
+// run on one clock, so the spread of their starts is the true skew the server's acknowledgements estimate
+void start_players(clock_type::time_point now)
+{
+	for (auto& player : players)
+	{
+		if (player.phase != phase_t::STARTING || now < player.start_at)
+		{
+			continue;
+		}
+
+		auto& room = rooms[player.room];
+		player.phase = phase_t::PLAYING;
+
+		if (player.sync_rtt < 1e9)
+		{
+			char message[64];
+			std::snprintf(message, sizeof(message), "proto=20;started=%.3f", to_ms(now) + player.offset);
+			send(player, message);
+		}
+
+		if (!room.started++)
+		{
+			room.first_start = now;
+		}
+
+		if (room.started == (int)room.players.size())
+		{
+			auto skew = std::chrono::duration<double, std::milli>(now - room.first_start).count();
+			totals.skew_ms += skew;
+			totals.skew_max_ms = std::max(totals.skew_max_ms, skew);
+
+			room.started_at = now;
+			room.last_death = now;
+		}
+	}
+}
+
+void handle(player_t& player, const char* data, clock_type::time_point now)
+{
+	auto& room = rooms[player.room];
+
+	switch (read_proto(data))
+	{
+		// NAME_CHANGE confirms the join
+		case 7:
+		{
+			if (player.phase != phase_t::JOINING)
+			{
+				break;
+			}
+
+			// A rejoining player only has to be back in the lobby, the room loop readies everyone up
+			if (player.rejoining)
+			{
+				auto took = std::chrono::duration<double, std::milli>(now - player.left_at).count();
+				++totals.reconnects;
+				totals.reconnect_ms += took;
+				totals.reconnect_max_ms = std::max(totals.reconnect_max_ms, took);
+
+				player.rejoining = false;
+				player.phase = phase_t::LOBBY;
+			}
+			else if (++room.joined == (int)room.players.size())
+			{
+				ready_up(room, now);
+			}
+		} break;
+
+		// USE_POWEWRUP, the target's copy names the attacker, the attacker's names the target
+		case 5:
+		{
+			auto powerup = find_field(data, "powerup");
+
+			if (!powerup || !find_field(data, "user"))
+			{
+				break;
+			}
+
+			auto index = (std::size_t)std::atoi(powerup);
+
+			if (index < powerups_sent.size())
+			{
+				auto took = std::chrono::duration<double, std::milli>(now - powerups_sent[index]).count();
+				++totals.powerups;
+				totals.powerup_ms += took;
+				totals.powerup_max_ms = std::max(totals.powerup_max_ms, took);
+			}
+		} break;
+
+		// CLOCK_SYNC reply
+		case 15:
+		{
+			auto t0 = find_field(data, "t0"), t1 = find_field(data, "t1"), t2 = find_field(data, "t2");
+
+			if (!t0 || !t1 || !t2)
+			{
+				break;
+			}
+
+			auto t3 = to_ms(now);
+			auto rtt = (t3 - std::atof(t0)) - (std::atof(t2) - std::atof(t1));
+
+			++player.syncs;
+
+			if (rtt < player.sync_rtt)
+			{
+				player.sync_rtt = rtt;
+				player.offset = ((std::atof(t1) - std::atof(t0)) + (std::atof(t2) - t3)) / 2.0;
+			}
+		} break;
+
+		// START_GAME, or MATCH_START when the server bundles the start
+		case 3:
+		case 14:
+		{
+			if (player.phase != phase_t::LOBBY)
+			{
+				break;
+			}
+
+			// A synced player holds the start until the scheduled server time like a real client would
+			auto start_at = find_field(data, "start_at");
+			player.phase = phase_t::STARTING;
+			player.start_at = now;
+
+			if (start_at && player.sync_rtt < 1e9)
+			{
+				auto scheduled = epoch + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double, std::milli>(std::atof(start_at) - player.offset));
+				player.start_at = std::max(now, scheduled);
+			}
+
+			if (std::none_of(room.players.begin(), room.players.end(), [](int index) { return players[index].phase == phase_t::LOBBY; }))
+			{
+				totals.start_ms += std::chrono::duration<double, std::milli>(now - room.ready_at).count();
+			}
+		} break;
+
+		// GRANT_WINNER
+		case 13:
+		{
+			if (player.phase != phase_t::PLAYING)
+			{
+				break;
+			}
+
+			player.phase = phase_t::LOBBY;
+
+			if (std::any_of(room.players.begin(), room.players.end(), [](int index) { return players[index].phase == phase_t::PLAYING; }))
+			{
+				break;
+			}
+
+			++totals.matches;
+			totals.match_ms += std::chrono::duration<double, std::milli>(now - room.started_at).count();
+			std::printf("Room %s finished match %i\n", room.id.c_str(), ++room.matches);
+		} break;
+	}
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+	const char* host = "127.0.0.1";
+	enet_uint16 port = 23363;
+	int room_size = 16;
+	int room_count = 1;
+	int match_count = 3;
+	int death_interval = 10;
+	auto reconnect = false;
+
+	for (auto i = 1; i < argc - 1; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-host") host = argv[++i];
+		else if (arg == "-port") port = (enet_uint16)std::atoi(argv[++i]);
+		else if (arg == "-players") room_size = std::max(2, std::atoi(argv[++i]));
+		else if (arg == "-rooms") room_count = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-matches") match_count = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "-death_interval") death_interval = std::max(0, std::atoi(argv[++i]));
+		else if (arg == "-reconnect") reconnect = std::atoi(argv[++i]) != 0;
+	}
+
+	// ENet caps a host at 4095 peers, one host per simulated player would only add sockets to poll.
+	// Every room has to fill for its matches to run, so a run that does not fit is refused rather than cut short
+	if ((long long)room_size * room_count > ENET_PROTOCOL_MAXIMUM_PEER_ID)
+	{
+		std::printf("%i room(s) of %i players need more than %i connections\n", room_count, room_size, ENET_PROTOCOL_MAXIMUM_PEER_ID);
+		return 1;
+	}
+
+	if (enet_initialize() != 0)
+	{
+		std::printf("Failed to start Enet\n");
+		return 1;
+	}
+
+	auto total = room_size * room_count;
+	auto client = enet_host_create(nullptr, total, 2, 0, 0);
+
+	if (!client)
+	{
+		std::printf("Unable to create the client host\n");
+		return 1;
+	}
+
+	ENetAddress address;
+	enet_address_set_host(&address, host);
+	address.port = port;
+
+	players.resize(total);
+	rooms.resize(room_count);
+
+	for (auto i = 0u; i < players.size(); ++i)
+	{
+		auto& player = players[i];
+		player.room = (int)i / room_size;
+		player.peer = enet_host_connect(client, &address, 2, 0);
+		player.peer->data = &player;
+
+		auto& room = rooms[player.room];
+		room.id = "load-" + std::to_string(player.room);
+		room.players.emplace_back((int)i);
+	}
+
+	// The server needs max_peers and room_capacity at least this large
+	std::printf("%i room(s) of %i players, %i match(es) each, against %s:%u\n", room_count, room_size, match_count, host, port);
+
+	auto began = clock_type::now();
+
+	while (!aborted && std::any_of(rooms.begin(), rooms.end(), [&](const room_t& room) { return room.matches < match_count; }))
+	{
+		ENetEvent evt;
+		auto now = clock_type::now();
+
+		while (enet_host_service(client, &evt, 1) > 0)
+		{
+			auto& player = *(player_t*)evt.peer->data;
+			now = clock_type::now();
+
+			switch (evt.type)
+			{
+				case ENET_EVENT_TYPE_CONNECT:
+				{
+					// Whoever connects first creates the room, for the rest it already exists and the server just says so
+					player.phase = phase_t::JOINING;
+					send(player, "proto=0;roomid=" + rooms[player.room].id + ";key=_");
+					send(player, "proto=1;roomid=" + rooms[player.room].id + ";key=_;name=p" + std::to_string(&player - players.data()));
+				} break;
+
+				case ENET_EVENT_TYPE_RECEIVE:
+				{
+					++player.packets;
+					player.bytes += evt.packet->dataLength;
+					handle(player, (const char*)evt.packet->data, now);
+					enet_packet_destroy(evt.packet);
+				} break;
+
+				case ENET_EVENT_TYPE_DISCONNECT:
+				{
+					// The slot is free again once the server has seen the disconnect, take a new connection right away
+					if (player.phase == phase_t::RECONNECTING)
+					{
+						player.phase = phase_t::CONNECTING;
+						player.rejoining = true;
+						player.sync_rtt = 1e9;
+						player.syncs = 0;
+						player.peer = enet_host_connect(client, &address, 2, 0);
+						player.peer->data = &player;
+						break;
+					}
+
+					// A room missing a player can never finish its script
+					std::printf("Player %i was disconnected (%u), stopping\n", (int)(&player - players.data()), evt.data);
+					player.phase = phase_t::DONE;
+					aborted = true;
+				} break;
+			}
+		}
+
+		now = clock_type::now();
+		sync_clocks(now);
+		start_players(now);
+
+		for (auto& room : rooms)
+		{
+			if (room.matches >= match_count || room.started_at < room.ready_at)
+			{
+				continue;
+			}
+
+			auto playing = std::all_of(room.players.begin(), room.players.end(), [](int index) { return players[index].phase == phase_t::PLAYING; });
+
+			// Everyone but the last player in the room dies, one every death_interval milliseconds
+			if (playing && room.next_death < (int)room.players.size() - 1 && now - room.last_death >= std::chrono::milliseconds(death_interval))
+			{
+				// Not before the last death, the match could be over by the time the powerup arrives
+				if (room.next_death < (int)room.players.size() - 2)
+				{
+					auto& survivor = players[room.players.back()];
+					powerups_sent.emplace_back(now);
+					send(survivor, "proto=5;powerup=" + std::to_string(powerups_sent.size() - 1) + ";mode=random");
+				}
+
+				auto& victim = players[room.players[room.next_death++]];
+				room.last_death = now;
+				send(victim, "proto=6");
+			}
+
+			// A finished match hands every player back to the lobby, the next one starts when all ready again
+			auto finished = std::all_of(room.players.begin(), room.players.end(), [](int index) { return players[index].phase == phase_t::LOBBY; });
+
+			if (finished && room.next_death && room.matches < match_count)
+			{
+				if (reconnect && room.reconnects < room.matches)
+				{
+					auto& leaver = players[room.players.front()];
+					leaver.phase = phase_t::RECONNECTING;
+					leaver.left_at = now;
+					++room.reconnects;
+					enet_peer_disconnect(leaver.peer, 0);
+				}
+				else
+				{
+					ready_up(room, now);
+				}
+			}
+		}
+	}
+
+	auto elapsed = std::chrono::duration<double>(clock_type::now() - began).count();
+	std::uint64_t packets = 0, bytes = 0;
+
+	for (auto& player : players)
+	{
+		packets += player.packets;
+		bytes += player.bytes;
+	}
+
+	auto per_match = [&](std::uint64_t value) { return (double)value / std::max<std::uint64_t>(totals.matches, 1) / room_size; };
+
+	std::printf("---------- %llu match(es) in %.2f s ----------\n", (unsigned long long)totals.matches, elapsed);
+	std::printf("Ready to start: %.1f ms average\n", totals.start_ms / std::max<std::uint64_t>(totals.matches, 1));
+	std::printf("Start skew: %.1f ms average, %.1f ms max\n", totals.skew_ms / std::max<std::uint64_t>(totals.matches, 1), totals.skew_max_ms);
+	std::printf("Start to winner: %.1f ms average\n", totals.match_ms / std::max<std::uint64_t>(totals.matches, 1));
+	std::printf("Powerup latency: %.1f ms average, %.1f ms max (%llu of %llu delivered)\n", totals.powerup_ms / std::max<std::uint64_t>(totals.powerups, 1), totals.powerup_max_ms, (unsigned long long)totals.powerups, (unsigned long long)powerups_sent.size());
+
+	if (reconnect)
+	{
+		std::printf("Reconnect to rejoined: %.1f ms average, %.1f ms max (%llu)\n", totals.reconnect_ms / std::max<std::uint64_t>(totals.reconnects, 1), totals.reconnect_max_ms, (unsigned long long)totals.reconnects);
+	}
+
+	std::printf("Received per player per match: %.1f packets, %.1f bytes\n", per_match(packets), per_match(bytes));
+
+	for (auto& player : players)
+	{
+		enet_peer_disconnect_now(player.peer, 0);
+	}
+
+	enet_host_flush(client);
+	enet_host_destroy(client);
+	enet_deinitialize();
+	return 0;
+}
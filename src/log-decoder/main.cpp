@@ -0,0 +1,337 @@
+#include "logger/binary_format.hpp"
+
+struct format_t
+{
+	std::uint8_t level;
+	std::string function;
+	std::string format;
+};
+
+struct arg_t
+{
+	std::uint8_t tag;
+	std::uint64_t value;
+	std::string string;
+};
+
+struct filter_t
+{
+	int min_level = 0;
+	std::string function;
+	std::string format;
+	int arg_index = -1;
+	std::string arg_value;
+};
+
+const char* level_names[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+template <typename T>
+bool read(std::FILE* file, T& value)
+{
+	return std::fread(&value, sizeof(value), 1, file) == 1;
+}
+
+bool read_string(std::FILE* file, std::string& value, std::size_t length)
+{
+	value.resize(length);
+	return !length || std::fread(&value[0], length, 1, file) == 1;
+}
+
+// Sized up front like logger::va, raw packet data can be far longer than any fixed buffer
+template <typename T>
+std::string format_value(const std::string& format, T value)
+{
+	auto length = std::snprintf(nullptr, 0, format.c_str(), value);
+
+	if (length <= 0)
+	{
+		return {};
+	}
+
+	std::string result(length, '\0');
+	std::snprintf(&result[0], length + 1, format.c_str(), value);
+	return result;
+}
+
+std::string render_arg(const std::string& spec, const arg_t& arg)
+{
+	auto conversion = spec.back();
+
+	// Length modifiers in the original format described the server's types, every value here is already widened.
+	// MSVC's I, I32 and I64 are accepted by the format checks too
+	std::string base;
+
+	for (auto i = 0u; i + 1 < spec.size(); ++i)
+	{
+		if (spec[i] == 'I')
+		{
+			if (spec.compare(i + 1, 2, "64") == 0 || spec.compare(i + 1, 2, "32") == 0)
+			{
+				i += 2;
+			}
+		}
+		else if (!std::strchr("hljztL", spec[i]))
+		{
+			base.push_back(spec[i]);
+		}
+	}
+
+	switch (arg.tag)
+	{
+		case binary_log::ARG_STRING:
+			return format_value(base + "s", arg.string.c_str());
+
+		case binary_log::ARG_FLOAT:
+		{
+			double value;
+			std::memcpy(&value, &arg.value, sizeof(value));
+			return format_value(base + conversion, value);
+		}
+
+		case binary_log::ARG_POINTER:
+			return format_value(base + "p", (void*)(std::uintptr_t)arg.value);
+
+		default:
+		{
+			if (conversion == 'c')
+			{
+				return format_value(base + "c", (int)arg.value);
+			}
+			else if (conversion == 'd' || conversion == 'i')
+			{
+				return format_value(base + "lld", (long long)arg.value);
+			}
+
+			return format_value(base + "ll" + conversion, (unsigned long long)arg.value);
+		}
+	}
+}
+
+std::string render(const format_t& format, const std::vector<arg_t>& args, std::vector<std::string>& rendered_args)
+{
+	std::string result;
+	auto next = 0u;
+	auto& text = format.format;
+
+	for (auto i = 0u; i < text.size(); ++i)
+	{
+		if (text[i] != '%')
+		{
+			result.push_back(text[i]);
+			continue;
+		}
+
+		if (i + 1 < text.size() && text[i + 1] == '%')
+		{
+			result.push_back('%');
+			++i;
+			continue;
+		}
+
+		auto end = text.find_first_of("diuoxXfFeEgGaAcspn", i + 1);
+
+		if (end == std::string::npos || next >= args.size())
+		{
+			result.append(text.substr(i));
+			break;
+		}
+
+		auto value = render_arg(text.substr(i, end - i + 1), args[next++]);
+		rendered_args.emplace_back(value);
+		result.append(value);
+		i = end;
+	}
+
+	return result;
+}
+
+bool matches(const filter_t& filter, const format_t& format, const std::vector<std::string>& rendered_args)
+{
+	if (format.level < filter.min_level)
+	{
+		return false;
+	}
+
+	if (!filter.function.empty() && format.function != filter.function)
+	{
+		return false;
+	}
+
+	if (!filter.format.empty() && format.format.find(filter.format) == std::string::npos)
+	{
+		return false;
+	}
+
+	if (filter.arg_index >= 0 && (filter.arg_index >= (int)rendered_args.size() || rendered_args[filter.arg_index] != filter.arg_value))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::printf("Usage: log-decoder <file> [-level INFO] [-function name] [-format text] [-arg N=value] [-time]\n");
+		return 1;
+	}
+
+	filter_t filter;
+	bool show_time = false;
+
+	for (auto i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-time")
+		{
+			show_time = true;
+		}
+		else if (i + 1 < argc && arg == "-level")
+		{
+			std::string level = argv[++i];
+
+			for (auto j = 0; j < 4; ++j)
+			{
+				if (level == level_names[j])
+				{
+					filter.min_level = j;
+				}
+			}
+		}
+		else if (i + 1 < argc && arg == "-function")
+		{
+			filter.function = argv[++i];
+		}
+		else if (i + 1 < argc && arg == "-format")
+		{
+			filter.format = argv[++i];
+		}
+		else if (i + 1 < argc && arg == "-arg")
+		{
+			std::string value = argv[++i];
+			auto split = value.find('=');
+
+			if (split != std::string::npos)
+			{
+				filter.arg_index = std::atoi(value.substr(0, split).c_str());
+				filter.arg_value = value.substr(split + 1);
+			}
+		}
+	}
+
+	auto file = std::fopen(argv[1], "rb");
+
+	if (!file)
+	{
+		std::printf("Unable to open \"%s\"\n", argv[1]);
+		return 1;
+	}
+
+	std::uint32_t header[2]{};
+
+	if (std::fread(header, sizeof(header), 1, file) != 1 || header[0] != binary_log::magic_value || header[1] != binary_log::format_version)
+	{
+		std::printf("\"%s\" is not a binary log this version can read\n", argv[1]);
+		std::fclose(file);
+		return 1;
+	}
+
+	std::unordered_map<std::uint32_t, format_t> formats;
+	std::uint8_t kind;
+
+	while (read(file, kind))
+	{
+		std::uint32_t id;
+
+		if (!read(file, id))
+		{
+			break;
+		}
+
+		if (kind == binary_log::FORMAT)
+		{
+			format_t format;
+			std::uint16_t length;
+
+			if (!read(file, format.level) || !read(file, length) || !read_string(file, format.function, length) || !read(file, length) || !read_string(file, format.format, length))
+			{
+				break;
+			}
+
+			formats[id] = format;
+			continue;
+		}
+
+		std::uint64_t time;
+		std::uint8_t arg_count;
+
+		if (!read(file, time) || !read(file, arg_count))
+		{
+			break;
+		}
+
+		std::vector<arg_t> args(arg_count);
+		bool truncated = false;
+
+		for (auto& arg : args)
+		{
+			if (!read(file, arg.tag))
+			{
+				truncated = true;
+				break;
+			}
+
+			if (arg.tag == binary_log::ARG_STRING)
+			{
+				std::uint32_t length;
+				truncated = !read(file, length) || !read_string(file, arg.string, length);
+			}
+			else
+			{
+				truncated = !read(file, arg.value);
+			}
+
+			if (truncated)
+			{
+				break;
+			}
+		}
+
+		if (truncated)
+		{
+			break;
+		}
+
+		auto format = formats.find(id);
+
+		if (format == formats.end())
+		{
+			std::printf("[ UNKNOWN FORMAT %u ]\n", id);
+			continue;
+		}
+
+		std::vector<std::string> rendered_args;
+		auto text = render(format->second, args, rendered_args);
+
+		if (!matches(filter, format->second, rendered_args))
+		{
+			continue;
+		}
+
+		if (show_time)
+		{
+			auto seconds = (std::time_t)(time / 1000000);
+			char stamp[32]{};
+			std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", std::gmtime(&seconds));
+			std::printf("%s.%06u ", stamp, (unsigned)(time % 1000000));
+		}
+
+		std::printf("[ %s ][%s]: %s\n", level_names[std::min<int>(format->second.level, 3)], format->second.function.c_str(), text.c_str());
+	}
+
+	std::fclose(file);
+	return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+//System
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std::literals;
+
+#include <Windows.h>
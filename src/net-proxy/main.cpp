@@ -0,0 +1,365 @@
+using clock_type = std::chrono::steady_clock;
+
+struct impairment_t
+{
+	double loss = 0.0;
+	int latency = 0;
+	int jitter = 0;
+	double duplicate = 0.0;
+	double reorder = 0.0;
+	int bandwidth = 0;
+	int queue_limit = 256 * 1024;
+};
+
+struct profile_t
+{
+	const char* name;
+	impairment_t impairment;
+};
+
+// Percentages, milliseconds and bytes per second, applied to each direction
+const profile_t profiles[] =
+{
+	{ "clean", { 0.0, 0, 0, 0.0, 0.0, 0 } },
+	{ "lan", { 0.0, 1, 1, 0.0, 0.0, 0 } },
+	{ "wifi", { 1.0, 15, 10, 0.1, 0.5, 0 } },
+	{ "mobile", { 3.0, 60, 40, 0.5, 2.0, 64 * 1024 } },
+	{ "lossy", { 10.0, 40, 20, 1.0, 5.0, 0 } },
+	{ "congested", { 2.0, 150, 80, 0.0, 1.0, 16 * 1024 } },
+};
+
+struct datagram_t
+{
+	clock_type::time_point deliver_at;
+	std::uint64_t sequence;
+	std::vector<std::uint8_t> data;
+
+	bool operator>(const datagram_t& other) const
+	{
+		return this->deliver_at != other.deliver_at ? this->deliver_at > other.deliver_at : this->sequence > other.sequence;
+	}
+};
+
+struct direction_t
+{
+	const char* name;
+	impairment_t impairment;
+	std::priority_queue<datagram_t, std::vector<datagram_t>, std::greater<datagram_t>> pending;
+	clock_type::time_point last_delivery;
+	clock_type::time_point link_free_at;
+	std::size_t queued_bytes = 0;
+	std::uint64_t sequence = 0;
+
+	std::uint64_t forwarded = 0;
+	std::uint64_t lost = 0;
+	std::uint64_t duplicated = 0;
+	std::uint64_t reordered = 0;
+	std::uint64_t overflowed = 0;
+};
+
+struct client_t
+{
+	ENetAddress address;
+	ENetSocket upstream;
+	direction_t to_server{ "client -> server" };
+	direction_t to_client{ "server -> client" };
+	clock_type::time_point last_seen;
+};
+
+std::mt19937 rng;
+
+bool chance(double percent)
+{
+	return percent > 0.0 && std::uniform_real_distribution<double>(0.0, 100.0)(rng) < percent;
+}
+
+void enqueue(direction_t& direction, const std::uint8_t* data, std::size_t length, clock_type::time_point now)
+{
+	auto& impairment = direction.impairment;
+
+	if (chance(impairment.loss))
+	{
+		++direction.lost;
+		return;
+	}
+
+	auto copies = chance(impairment.duplicate) ? 2 : 1;
+	direction.duplicated += copies - 1;
+
+	for (auto copy = 0; copy < copies; ++copy)
+	{
+		if (impairment.queue_limit && direction.queued_bytes + length > (std::size_t)impairment.queue_limit)
+		{
+			++direction.overflowed;
+			continue;
+		}
+
+		auto delay = impairment.latency;
+
+		if (impairment.jitter)
+		{
+			delay += std::uniform_int_distribution<int>(-impairment.jitter, impairment.jitter)(rng);
+		}
+
+		auto deliver_at = now + std::chrono::milliseconds(std::max(0, delay));
+
+		// Serialise onto the capped link, a full link turns into queueing delay and then tail drops
+		if (impairment.bandwidth)
+		{
+			auto start = std::max(now, direction.link_free_at);
+			direction.link_free_at = start + std::chrono::microseconds(length * 1000000 / impairment.bandwidth);
+			deliver_at = std::max(deliver_at, direction.link_free_at);
+		}
+
+		// Jitter alone keeps order like a real queue would, reordering holds one packet back past its successors
+		if (chance(impairment.reorder))
+		{
+			++direction.reordered;
+			deliver_at += std::chrono::milliseconds(impairment.jitter * 2 + 10);
+		}
+		else
+		{
+			deliver_at = std::max(deliver_at, direction.last_delivery);
+			direction.last_delivery = deliver_at;
+		}
+
+		direction.queued_bytes += length;
+		direction.pending.push({ deliver_at, direction.sequence++, std::vector<std::uint8_t>(data, data + length) });
+	}
+}
+
+void deliver(direction_t& direction, ENetSocket socket, const ENetAddress& to, clock_type::time_point now)
+{
+	while (!direction.pending.empty() && direction.pending.top().deliver_at <= now)
+	{
+		auto& datagram = direction.pending.top();
+
+		ENetBuffer buffer;
+		buffer.data = (void*)datagram.data.data();
+		buffer.dataLength = datagram.data.size();
+		enet_socket_send(socket, &to, &buffer, 1);
+
+		direction.queued_bytes -= datagram.data.size();
+		++direction.forwarded;
+		direction.pending.pop();
+	}
+}
+
+void print_direction(const direction_t& direction)
+{
+	std::printf(
+		"  %-18s forwarded %llu, lost %llu, duplicated %llu, reordered %llu, overflowed %llu, queued %u bytes\n",
+		direction.name,
+		direction.forwarded,
+		direction.lost,
+		direction.duplicated,
+		direction.reordered,
+		direction.overflowed,
+		(unsigned)direction.queued_bytes
+	);
+}
+
+void usage()
+{
+	std::printf("Usage: net-proxy [-listen port] [-target host:port] [-profile name] [-loss %%] [-latency ms] [-jitter ms]\n");
+	std::printf("                 [-duplicate %%] [-reorder %%] [-bandwidth bytes/s] [-queue bytes] [-seed n] [-stats seconds]\n");
+	std::printf("Profiles:");
+
+	for (auto& profile : profiles)
+	{
+		std::printf(" %s", profile.name);
+	}
+
+	std::printf("\n");
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+	unsigned int listen_port = 23364;
+	std::string target = "127.0.0.1:23363";
+	impairment_t impairment;
+	int stats_interval = 5;
+	unsigned int seed = std::random_device()();
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (i + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+
+		std::string value = argv[++i];
+
+		if (arg == "-listen") listen_port = std::atoi(value.c_str());
+		else if (arg == "-target") target = value;
+		else if (arg == "-loss") impairment.loss = std::atof(value.c_str());
+		else if (arg == "-latency") impairment.latency = std::atoi(value.c_str());
+		else if (arg == "-jitter") impairment.jitter = std::atoi(value.c_str());
+		else if (arg == "-duplicate") impairment.duplicate = std::atof(value.c_str());
+		else if (arg == "-reorder") impairment.reorder = std::atof(value.c_str());
+		else if (arg == "-bandwidth") impairment.bandwidth = std::atoi(value.c_str());
+		else if (arg == "-queue") impairment.queue_limit = std::atoi(value.c_str());
+		else if (arg == "-seed") seed = (unsigned int)std::strtoul(value.c_str(), nullptr, 10);
+		else if (arg == "-stats") stats_interval = std::atoi(value.c_str());
+		else if (arg == "-profile")
+		{
+			auto found = false;
+
+			for (auto& profile : profiles)
+			{
+				if (value == profile.name)
+				{
+					// Later flags still override single values of the profile
+					impairment = profile.impairment;
+					found = true;
+				}
+			}
+
+			if (!found)
+			{
+				usage();
+				return 1;
+			}
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	rng.seed(seed);
+
+	if (enet_initialize() != 0)
+	{
+		std::printf("Failed to start Enet\n");
+		return 1;
+	}
+
+	ENetAddress server_address{};
+	auto split = target.rfind(':');
+	enet_address_set_host(&server_address, target.substr(0, split).c_str());
+	server_address.port = split == std::string::npos ? 23363 : (enet_uint16)std::atoi(target.substr(split + 1).c_str());
+
+	ENetAddress listen_address{};
+	listen_address.host = ENET_HOST_ANY;
+	listen_address.port = (enet_uint16)listen_port;
+
+	auto listener = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+
+	if (listener == ENET_SOCKET_NULL || enet_socket_bind(listener, &listen_address) < 0)
+	{
+		std::printf("Unable to listen on port %u\n", listen_port);
+		return 1;
+	}
+
+	enet_socket_set_option(listener, ENET_SOCKOPT_NONBLOCK, 1);
+
+	std::printf(
+		"Proxying :%u -> %s (seed %u): loss %.1f%%, latency %i ms +/- %i ms, duplicate %.1f%%, reorder %.1f%%, bandwidth %i B/s\n",
+		listen_port,
+		target.c_str(),
+		seed,
+		impairment.loss,
+		impairment.latency,
+		impairment.jitter,
+		impairment.duplicate,
+		impairment.reorder,
+		impairment.bandwidth
+	);
+
+	std::vector<std::unique_ptr<client_t>> clients;
+	std::uint8_t data[4096];
+	auto last_stats = clock_type::now();
+
+	while (true)
+	{
+		// Wake up at least every millisecond so delayed datagrams leave close to on time
+		enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+		enet_socket_wait(listener, &condition, 1);
+
+		auto now = clock_type::now();
+
+		ENetAddress from;
+		ENetBuffer buffer;
+		buffer.data = data;
+		buffer.dataLength = sizeof(data);
+
+		int length;
+
+		while ((length = enet_socket_receive(listener, &from, &buffer, 1)) > 0)
+		{
+			auto client = std::find_if(clients.begin(), clients.end(), [&](const std::unique_ptr<client_t>& client)
+			{
+				return client->address.host == from.host && client->address.port == from.port;
+			});
+
+			if (client == clients.end())
+			{
+				// One upstream socket per client so the server sees each of them as its own peer
+				auto fresh = std::make_unique<client_t>();
+				fresh->address = from;
+				fresh->upstream = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+				fresh->to_server.impairment = impairment;
+				fresh->to_client.impairment = impairment;
+
+				if (fresh->upstream == ENET_SOCKET_NULL)
+				{
+					continue;
+				}
+
+				enet_socket_set_option(fresh->upstream, ENET_SOCKOPT_NONBLOCK, 1);
+				std::printf("New client %u:%u\n", from.host, from.port);
+
+				clients.emplace_back(std::move(fresh));
+				client = clients.end() - 1;
+			}
+
+			(*client)->last_seen = now;
+			enqueue((*client)->to_server, data, length, now);
+		}
+
+		for (auto& client : clients)
+		{
+			ENetAddress upstream_from;
+
+			while ((length = enet_socket_receive(client->upstream, &upstream_from, &buffer, 1)) > 0)
+			{
+				enqueue(client->to_client, data, length, now);
+			}
+
+			deliver(client->to_server, client->upstream, server_address, now);
+			deliver(client->to_client, listener, client->address, now);
+		}
+
+		// Forget clients that went quiet so long runs with many reconnects do not pile up sockets
+		clients.erase(std::remove_if(clients.begin(), clients.end(), [&](const std::unique_ptr<client_t>& client)
+		{
+			if (now - client->last_seen < 60s || !client->to_server.pending.empty() || !client->to_client.pending.empty())
+			{
+				return false;
+			}
+
+			enet_socket_destroy(client->upstream);
+			return true;
+		}), clients.end());
+
+		if (stats_interval > 0 && now - last_stats >= std::chrono::seconds(stats_interval))
+		{
+			last_stats = now;
+			std::printf("---------- %u client(s) ----------\n", (unsigned)clients.size());
+
+			for (auto& client : clients)
+			{
+				std::printf("%u:%u\n", client->address.host, client->address.port);
+				print_direction(client->to_server);
+				print_direction(client->to_client);
+			}
+		}
+	}
+
+	return 0;
+}
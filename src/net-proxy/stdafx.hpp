@@ -0,0 +1,22 @@
+#pragma once
+
+//System
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+using namespace std::literals;
+
+#include <Windows.h>
+
+//Deps
+#include <enet/enet.h>
@@ -0,0 +1,103 @@
+#include "bandwidth.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "networking/networking.hpp"
+#include "metrics/metrics.hpp"
+
+std::chrono::steady_clock::time_point bandwidth::last_update;
+
+void bandwidth::configure_peer(ENetPeer* peer, peer_link_t& link)
+{
+	// Nothing has been measured yet, start from the clean profile
+	bandwidth::apply(peer, link, false, (enet_uint32)config::throttle_interval, (enet_uint32)config::peer_timeout_min);
+}
+
+void bandwidth::update()
+{
+	auto now = networking::event_time;
+
+	if (now - bandwidth::last_update < std::chrono::seconds(1))
+	{
+		return;
+	}
+
+	bandwidth::last_update = now;
+
+	for (auto host : networking::hosts)
+	{
+		for (auto i = 0u; i < host->peerCount; ++i)
+		{
+			auto peer = &host->peers[i];
+
+			if (peer->state != ENET_PEER_STATE_CONNECTED || !peer->data)
+			{
+				continue;
+			}
+
+			auto& link = networking::get_state(peer)->link;
+			auto loss = peer->packetLoss * 100 / ENET_PEER_PACKET_LOSS_SCALE;
+
+			// Hysteresis keeps a link hovering around one threshold from flapping between profiles
+			auto lossy = link.lossy ? loss >= (enet_uint32)config::loss_low : loss >= (enet_uint32)config::loss_high;
+
+			// React within a few round trips, never faster than the RTT can be measured
+			auto interval = std::clamp<enet_uint32>(peer->roundTripTime * 4, 250, (enet_uint32)config::throttle_interval);
+
+			// A reliable command is only given up on after several RTTs of silence
+			auto timeout_minimum = std::max<enet_uint32>((enet_uint32)config::peer_timeout_min, (peer->roundTripTime + 4 * peer->roundTripTimeVariance) * 8);
+			timeout_minimum = std::min<enet_uint32>(timeout_minimum, (enet_uint32)config::peer_timeout_max);
+
+			bandwidth::apply(peer, link, lossy, interval, timeout_minimum);
+		}
+	}
+}
+
+bool bandwidth::charge_room(room_t& room, std::size_t bytes)
+{
+	if (config::room_bandwidth <= 0)
+	{
+		return true;
+	}
+
+	if (room.budget.take(config::room_bandwidth, config::room_bandwidth, networking::event_time, (double)bytes))
+	{
+		return true;
+	}
+
+	// Whatever goes out still uses the link, so the room runs into debt (at most a second's worth) and has to earn it back
+	room.budget.tokens = std::max(room.budget.tokens - bytes, -(double)config::room_bandwidth);
+	metrics::record_room_over_budget(bytes);
+	return false;
+}
+
+void bandwidth::apply(ENetPeer* peer, peer_link_t& link, bool lossy, enet_uint32 interval, enet_uint32 timeout_minimum)
+{
+	// Throttle changes are sent to the client as a reliable command, only send them when something moved
+	if (lossy != link.lossy || !link.throttle_interval || (interval > link.throttle_interval * 2 || interval * 2 < link.throttle_interval))
+	{
+		if (lossy != link.lossy)
+		{
+			PRINT_DEBUG("%s is now %s (%u%% loss, %u ms)", networking::get_ip(peer->address).c_str(), lossy ? "lossy" : "clean", peer->packetLoss * 100 / ENET_PEER_PACKET_LOSS_SCALE, peer->roundTripTime);
+		}
+
+		link.lossy = lossy;
+		link.throttle_interval = interval;
+
+		if (lossy)
+		{
+			enet_peer_throttle_configure(peer, interval, 1, 4);
+		}
+		else
+		{
+			enet_peer_throttle_configure(peer, interval, ENET_PEER_PACKET_THROTTLE_ACCELERATION, ENET_PEER_PACKET_THROTTLE_DECELERATION);
+		}
+	}
+
+	// Purely local, free to adjust every pass. Silence of a few times the minimum means the peer is gone however
+	// few retransmits fit in it, so the maximum follows the RTT too instead of waiting out the flat cap
+	if (timeout_minimum != link.timeout_minimum)
+	{
+		link.timeout_minimum = timeout_minimum;
+		enet_peer_timeout(peer, (enet_uint32)config::peer_timeout_limit, timeout_minimum, std::clamp<enet_uint32>(timeout_minimum * 3, timeout_minimum, (enet_uint32)config::peer_timeout_max));
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+struct room_t;
+
+struct peer_link_t
+{
+	bool lossy = false;
+	enet_uint32 throttle_interval = 0;
+	enet_uint32 timeout_minimum = 0;
+};
+
+// ENet's throttle and timeouts tuned per peer from the RTT and loss it measures. Clean links
+// recover quickly after a dip, lossy ones back off harder and ramp up gently so delivery stays smooth,
+// and timeouts scale with RTT so dead peers are noticed fast without dropping slow but live ones
+class bandwidth final
+{
+public:
+	static void configure_peer(ENetPeer* peer, peer_link_t& link);
+	static void update();
+
+	// Charges a room's send budget, false means it is spent and non-critical traffic should be downgraded
+	static bool charge_room(room_t& room, std::size_t bytes);
+
+private:
+	static void apply(ENetPeer* peer, peer_link_t& link, bool lossy, enet_uint32 interval, enet_uint32 timeout_minimum);
+
+	static std::chrono::steady_clock::time_point last_update;
+};
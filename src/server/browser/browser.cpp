@@ -0,0 +1,281 @@
+#include "browser.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "networking/networking.hpp"
+#include "congestion/congestion.hpp"
+#include "metrics/metrics.hpp"
+#include "recorder/recorder.hpp"
+
+std::uint64_t browser::version = 1;
+std::uint64_t browser::built_version = 0;
+std::vector<int> browser::touched;
+std::array<listing_view_t, browser::view_count> browser::views;
+std::chrono::steady_clock::time_point browser::last_update;
+
+void browser::handle(ENetPeer* peer, const std::vector<std::string>& split_packet)
+{
+	auto page = 0;
+	auto view = 0;
+	std::uint64_t known = 0;
+
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		auto& field = split_packet[i];
+
+		if (field.rfind("page=", 0) == 0)
+		{
+			page = std::atoi(field.c_str() + 5);
+		}
+		else if (field.rfind("public=", 0) == 0 && std::atoi(field.c_str() + 7))
+		{
+			view |= 1;
+		}
+		else if (field.rfind("open=", 0) == 0 && std::atoi(field.c_str() + 5))
+		{
+			view |= 2;
+		}
+		else if (field.rfind("version=", 0) == 0)
+		{
+			known = std::strtoull(field.c_str() + 8, nullptr, 10);
+		}
+	}
+
+	browser::update();
+
+	auto& pages = browser::views[view].pages;
+
+	if (page >= 0 && page < (int)pages.size())
+	{
+		auto& entry = pages[page];
+
+		// A client polling with the version of the page it already has gets a few bytes back instead of the page
+		if (known == entry.version)
+		{
+			networking::send_packet(proto_t::GET_ROOM_LIST, peer, FORMAT_VA("version=%llu;unchanged=1;", (unsigned long long)entry.version));
+			return;
+		}
+
+		recorder::record(recorder_event_t::SEND, peer, proto_t::GET_ROOM_LIST, -1, (std::uint32_t)entry.packet->dataLength);
+		metrics::record_send(proto_t::GET_ROOM_LIST, entry.packet->dataLength);
+		networking::send_to_peer(peer, proto_t::GET_ROOM_LIST, entry.packet);
+		return;
+	}
+
+	networking::send_packet(
+		proto_t::GET_ROOM_LIST,
+		peer,
+		FORMAT_VA("version=%llu;rooms=%i;page=%i;pages=%i;", (unsigned long long)browser::built_version, (int)browser::views[view].rooms.size(), page, (int)pages.size())
+	);
+}
+
+void browser::touch(int room)
+{
+	auto& entry = networking::rooms[room].listing;
+
+	if (!entry.stale)
+	{
+		entry.stale = true;
+		browser::touched.emplace_back(room);
+	}
+
+	++browser::version;
+}
+
+void browser::erase_room(int room)
+{
+	browser::touched.erase(std::remove(browser::touched.begin(), browser::touched.end(), room), browser::touched.end());
+
+	for (auto& index : browser::touched)
+	{
+		if (index > room)
+		{
+			--index;
+		}
+	}
+
+	// Only pages from the erased room on lose an entry, everything after it just renumbers
+	for (auto& view : browser::views)
+	{
+		auto position = (std::size_t)(std::lower_bound(view.rooms.begin(), view.rooms.end(), room) - view.rooms.begin());
+
+		if (position < view.rooms.size() && view.rooms[position] == room)
+		{
+			view.rooms.erase(view.rooms.begin() + position);
+			browser::mark_from(view, position);
+		}
+
+		for (auto i = position; i < view.rooms.size(); ++i)
+		{
+			--view.rooms[i];
+		}
+	}
+
+	++browser::version;
+}
+
+void browser::cleanup()
+{
+	for (auto& view : browser::views)
+	{
+		for (auto& page : view.pages)
+		{
+			browser::release_page(page);
+		}
+
+		view.pages.clear();
+		view.rooms.clear();
+	}
+
+	browser::touched.clear();
+}
+
+void browser::update()
+{
+	if (browser::built_version == browser::version)
+	{
+		return;
+	}
+
+	// Churn in a busy lobby would otherwise patch pages on nearly every request, a slightly old list is fine
+	// for browsing and the page versions tell the client a newer one is coming
+	if (browser::built_version && networking::event_time - browser::last_update < std::chrono::milliseconds(config::room_list_refresh))
+	{
+		return;
+	}
+
+	auto rendered = (int)browser::touched.size();
+
+	for (auto room : browser::touched)
+	{
+		auto& entry = networking::rooms[room];
+		browser::render(entry);
+		browser::place(room, (entry.key == "_" ? 1 : 0) | (!entry.playing && entry.players.size() < (std::size_t)config::room_capacity ? 2 : 0));
+	}
+
+	browser::touched.clear();
+
+	auto built = 0;
+
+	for (auto& view : browser::views)
+	{
+		auto page_count = (view.rooms.size() + config::room_list_page - 1) / config::room_list_page;
+
+		// Every page carries the page count, so pages appearing or going away touch all of them
+		if (page_count != view.pages.size())
+		{
+			for (auto i = page_count; i < view.pages.size(); ++i)
+			{
+				browser::release_page(view.pages[i]);
+			}
+
+			view.pages.resize(page_count);
+
+			for (auto& page : view.pages)
+			{
+				page.stale = true;
+			}
+		}
+
+		for (auto i = 0u; i < view.pages.size(); ++i)
+		{
+			if (view.pages[i].stale)
+			{
+				browser::build_page(view, (int)i);
+				++built;
+			}
+		}
+	}
+
+	browser::built_version = browser::version;
+	browser::last_update = networking::event_time;
+
+	PRINT_DEBUG("Room list version %llu built, %i entries rendered, %i pages encoded", (unsigned long long)browser::built_version, rendered, built);
+}
+
+void browser::render(room_t& room)
+{
+	// The id goes last so any commas in it survive splitting the other fields off
+	room.listing.text = FORMAT_VA(
+		"%i,%i,%i,%i,%s",
+		(int)(room.key == "_"),
+		(int)room.players.size(),
+		config::room_capacity,
+		(int)room.playing,
+		room.id.c_str()
+	);
+
+	room.listing.stale = false;
+}
+
+// Moves a room into or out of every view whose filter it now passes or fails. Views list rooms in room order,
+// so a room that stays put only touches its own page while one that comes or goes shifts the pages after it
+void browser::place(int room, int flags)
+{
+	for (auto i = 0; i < browser::view_count; ++i)
+	{
+		auto& view = browser::views[i];
+		auto position = (std::size_t)(std::lower_bound(view.rooms.begin(), view.rooms.end(), room) - view.rooms.begin());
+		auto listed = position < view.rooms.size() && view.rooms[position] == room;
+		auto shown = (flags & i) == i;
+
+		if (listed && shown)
+		{
+			auto page = position / config::room_list_page;
+
+			if (page < view.pages.size())
+			{
+				view.pages[page].stale = true;
+			}
+		}
+		else if (shown)
+		{
+			view.rooms.insert(view.rooms.begin() + position, room);
+			browser::mark_from(view, position);
+		}
+		else if (listed)
+		{
+			view.rooms.erase(view.rooms.begin() + position);
+			browser::mark_from(view, position);
+		}
+	}
+}
+
+void browser::mark_from(listing_view_t& view, std::size_t position)
+{
+	for (auto page = position / config::room_list_page; page < view.pages.size(); ++page)
+	{
+		view.pages[page].stale = true;
+	}
+}
+
+void browser::build_page(listing_view_t& view, int page)
+{
+	auto first = (std::size_t)page * config::room_list_page;
+	auto last = std::min(first + config::room_list_page, view.rooms.size());
+
+	auto info = FORMAT_VA("version=%llu;page=%i;pages=%i;", (unsigned long long)browser::version, page, (int)view.pages.size());
+
+	for (auto i = first; i < last; ++i)
+	{
+		FORMAT_APPEND(info, "r%i=%s;", (int)(i - first), networking::rooms[view.rooms[i]].listing.text.c_str());
+	}
+
+	auto& entry = view.pages[page];
+	browser::release_page(entry);
+
+	entry.packet = networking::create_packet(proto_t::GET_ROOM_LIST, info);
+	++entry.packet->referenceCount;
+	entry.version = browser::version;
+	entry.stale = false;
+}
+
+// Requests still queued with ENet hold their own references, the packet goes once the last of them is sent
+void browser::release_page(listing_page_t& page)
+{
+	if (page.packet)
+	{
+		--page.packet->referenceCount;
+		congestion::release(page.packet);
+		page.packet = nullptr;
+	}
+}
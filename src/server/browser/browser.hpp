@@ -0,0 +1,57 @@
+#pragma once
+
+struct room_t;
+
+// A room's listing text, rendered again only after the room changes
+struct listing_entry_t
+{
+	std::string text;
+	bool stale = false;
+};
+
+// One page of a filtered view. The packet is encoded once and every request for the page queues that same
+// packet, the listing keeps a reference of its own so ENet never frees it while the page is current
+struct listing_page_t
+{
+	ENetPacket* packet = nullptr;
+	std::uint64_t version = 0;
+	bool stale = true;
+};
+
+// The rooms one filter combination shows, in room order, and the pages they are split into
+struct listing_view_t
+{
+	std::vector<int> rooms;
+	std::vector<listing_page_t> pages;
+};
+
+class browser final
+{
+public:
+	static void handle(ENetPeer* peer, const std::vector<std::string>& split_packet);
+
+	// Queues a room's entry to be rendered again, call whenever anything the listing shows about it changes
+	static void touch(int room);
+
+	// The room is leaving the room list, rooms after it move down a slot
+	static void erase_room(int room);
+
+	static void cleanup();
+
+	// Index bit 0 keeps only public rooms, bit 1 only rooms that can be joined
+	static constexpr int view_count = 4;
+
+private:
+	static void update();
+	static void render(room_t& room);
+	static void place(int room, int flags);
+	static void mark_from(listing_view_t& view, std::size_t position);
+	static void build_page(listing_view_t& view, int page);
+	static void release_page(listing_page_t& page);
+
+	static std::uint64_t version;
+	static std::uint64_t built_version;
+	static std::vector<int> touched;
+	static std::array<listing_view_t, view_count> views;
+	static std::chrono::steady_clock::time_point last_update;
+};
@@ -0,0 +1,239 @@
+#include "capture.hpp"
+#include "logger/logger.hpp"
+#include "global/global.hpp"
+#include "config/config.hpp"
+#include "networking/networking.hpp"
+
+#include <map>
+
+std::FILE* capture::file;
+std::chrono::steady_clock::time_point capture::epoch;
+std::chrono::steady_clock::time_point capture::last_flush;
+
+void capture::init()
+{
+	capture::epoch = std::chrono::steady_clock::now();
+
+	// Level lists are the only random input, seeding from the capture makes a replay draw the same ones
+	std::uint32_t seed = std::random_device()();
+
+	if (!config::replay.empty())
+	{
+		networking::loopback = true;
+		return;
+	}
+
+	networking::rng.seed(seed);
+
+	if (config::capture.empty())
+	{
+		return;
+	}
+
+	capture::file = std::fopen(config::capture.c_str(), "wb");
+
+	if (!capture::file)
+	{
+		PRINT_ERROR("Unable to open capture file \"%s\"", config::capture.c_str());
+		return;
+	}
+
+	std::setvbuf(capture::file, nullptr, _IOFBF, 1 << 16);
+
+	std::uint32_t header[] = { capture::magic_value, capture::format_version, seed };
+	std::fwrite(header, sizeof(header), 1, capture::file);
+
+	PRINT_INFO("Capturing traffic to \"%s\"", config::capture.c_str());
+}
+
+void capture::record(const ENetEvent& evt)
+{
+	if (!capture::file)
+	{
+		return;
+	}
+
+	record_t record{};
+	record.type = (std::uint8_t)evt.type;
+	record.host = networking::get_host_index(evt.peer->host);
+	record.peer = evt.peer->incomingPeerID;
+	record.rtt = (std::uint16_t)std::min<enet_uint32>(evt.peer->roundTripTime, UINT16_MAX);
+	record.rtt_variance = (std::uint16_t)std::min<enet_uint32>(evt.peer->roundTripTimeVariance, UINT16_MAX);
+	record.time_ns = capture::get_time_ns();
+
+	if (evt.type == ENET_EVENT_TYPE_RECEIVE)
+	{
+		record.length = (std::uint32_t)evt.packet->dataLength;
+		std::fwrite(&record, sizeof(record), 1, capture::file);
+		std::fwrite(evt.packet->data, evt.packet->dataLength, 1, capture::file);
+		return;
+	}
+
+	record.length = sizeof(ENetAddress);
+	std::fwrite(&record, sizeof(record), 1, capture::file);
+	std::fwrite(&evt.peer->address, sizeof(ENetAddress), 1, capture::file);
+}
+
+void capture::record_tick()
+{
+	if (!capture::file)
+	{
+		return;
+	}
+
+	record_t record{};
+	record.type = (std::uint8_t)ENET_EVENT_TYPE_NONE;
+	record.time_ns = capture::get_time_ns();
+	std::fwrite(&record, sizeof(record), 1, capture::file);
+}
+
+void capture::update()
+{
+	if (!capture::file)
+	{
+		return;
+	}
+
+	// Keeps at most a second of traffic in the stdio buffer if the process is killed
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - capture::last_flush >= 1s)
+	{
+		capture::last_flush = now;
+		std::fflush(capture::file);
+	}
+}
+
+void capture::replay()
+{
+	auto input = std::fopen(config::replay.c_str(), "rb");
+
+	if (!input)
+	{
+		PRINT_ERROR("Unable to open replay file \"%s\"", config::replay.c_str());
+		global::shutdown = true;
+		return;
+	}
+
+	std::uint32_t header[3]{};
+
+	if (std::fread(header, sizeof(header), 1, input) != 1 || header[0] != capture::magic_value || header[1] != capture::format_version)
+	{
+		PRINT_ERROR("\"%s\" is not a capture this version can replay", config::replay.c_str());
+		std::fclose(input);
+		global::shutdown = true;
+		return;
+	}
+
+	networking::rng.seed(header[2]);
+
+	PRINT_INFO("Replaying \"%s\" %s", config::replay.c_str(), config::replay_speed ? "at recorded speed" : "as fast as possible");
+
+	// One stand-in per ENet slot, reused by every connection the slot takes like the slot itself is
+	std::map<std::pair<std::uint16_t, std::uint16_t>, std::unique_ptr<ENetPeer>> peers;
+	std::vector<std::uint8_t> data;
+	std::uint64_t events = 0;
+	record_t record;
+
+	// Through the normal disconnect path, so the room has let go of the peer before it is reused or freed
+	auto release = [](ENetPeer* peer)
+	{
+		if (!peer->data)
+		{
+			return;
+		}
+
+		ENetEvent evt{};
+		evt.type = ENET_EVENT_TYPE_DISCONNECT;
+		evt.peer = peer;
+		networking::handle_event(evt);
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	while (std::fread(&record, sizeof(record), 1, input) == 1)
+	{
+		data.resize(record.length);
+
+		if (record.length && std::fread(data.data(), record.length, 1, input) != 1)
+		{
+			PRINT_WARNING("Capture ends mid record");
+			break;
+		}
+
+		if (config::replay_speed)
+		{
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.time_ns));
+		}
+
+		networking::event_time = start + std::chrono::nanoseconds(record.time_ns);
+
+		if (record.type == ENET_EVENT_TYPE_NONE)
+		{
+			networking::tick();
+			continue;
+		}
+
+		auto& peer = peers[{ record.host, record.peer }];
+
+		if (!peer)
+		{
+			peer = std::make_unique<ENetPeer>();
+			std::memset(peer.get(), 0, sizeof(ENetPeer));
+			peer->incomingPeerID = record.peer;
+		}
+		else if (record.type == ENET_EVENT_TYPE_CONNECT)
+		{
+			// A live server always dispatches the disconnect first, a capture cut short may not have it
+			release(peer.get());
+		}
+
+		peer->roundTripTime = record.rtt;
+		peer->roundTripTimeVariance = record.rtt_variance;
+
+		ENetEvent evt{};
+		evt.type = (ENetEventType)record.type;
+		evt.peer = peer.get();
+
+		if (evt.type == ENET_EVENT_TYPE_RECEIVE)
+		{
+			evt.packet = enet_packet_create(data.data(), data.size(), ENET_PACKET_FLAG_RELIABLE);
+		}
+		else if (record.length == sizeof(ENetAddress))
+		{
+			std::memcpy(&peer->address, data.data(), sizeof(ENetAddress));
+		}
+
+		networking::dispatch_event(evt);
+		++events;
+	}
+
+	// Whoever was still connected when the capture ended leaves now, before the stand-ins go away
+	for (auto& entry : peers)
+	{
+		release(entry.second.get());
+	}
+
+	std::fclose(input);
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	PRINT_INFO("Replayed %llu events in %.3f s (%.0f events/s)", events, elapsed, elapsed > 0 ? events / elapsed : 0.0);
+	PRINT_INFO("Loopback sent %llu packets, %llu bytes", networking::packets_sent, networking::bytes_sent);
+
+	global::shutdown = true;
+}
+
+std::uint64_t capture::get_time_ns()
+{
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(networking::event_time - capture::epoch).count();
+}
+
+void capture::cleanup()
+{
+	if (capture::file)
+	{
+		std::fclose(capture::file);
+		capture::file = nullptr;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Append-only capture of every ENet event the server dispatches, and a replay mode that
+// feeds a capture back through networking::dispatch_event over the loopback transport
+class capture final
+{
+public:
+	static constexpr std::uint32_t magic_value = 0x43474550; // "PEGC"
+	static constexpr std::uint32_t format_version = 2;
+
+	// A type of ENET_EVENT_TYPE_NONE marks a pass of the main loop, where networking::tick ran
+	struct record_t
+	{
+		std::uint8_t type;
+		std::uint8_t reserved;
+		std::uint16_t host;
+		std::uint16_t peer;
+
+		// The peer's smoothed RTT and its variance in ms, stand-in peers take them over on replay
+		std::uint16_t rtt;
+		std::uint64_t time_ns;
+		std::uint32_t length;
+		std::uint16_t rtt_variance;
+		std::uint16_t reserved_2;
+	};
+
+	static void init();
+	static void record(const ENetEvent& evt);
+	static void record_tick();
+	static void update();
+	static void replay();
+	static void cleanup();
+
+private:
+	static std::uint64_t get_time_ns();
+
+	static std::FILE* file;
+	static std::chrono::steady_clock::time_point epoch;
+	static std::chrono::steady_clock::time_point last_flush;
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+
+// Shared by the server and clients, both ends have to agree on the exact dictionary.
+// Change model_version whenever the dictionary changes so old clients are turned away at connect
+namespace codec
+{
+	constexpr enet_uint32 model_version = 1;
+
+	// Bytes 0x80..0xFE stand for these, 0xFF escapes a literal byte from that range.
+	// Chosen from the message vocabulary, longest match wins
+	constexpr const char* dictionary[] =
+	{
+		"proto=0;", "proto=1;", "proto=2;", "proto=3;", "proto=4;", "proto=5;", "proto=6;",
+		"proto=7;", "proto=8;", "proto=9;", "proto=10;", "proto=11;", "proto=12;", "proto=13;",
+		"proto=", "roomid=", "key=_;", "key=", "name=", "powerup=", "user=", "winner=",
+		";0=", ";1=", ";2=", ";3=", ";4=", ";5=", ";6=", ";7=", ";8=", ";9=",
+		";10=", ";11=", ";12=", ";13=", ";14=", ";15=", ";16=", ";17=", ";18=", ";19=",
+		";20=", ";21=", ";22=", ";23=", ";24=", ";25=", ";26=", ";27=", ";28=", ";29=",
+		";30=", ";31=", ";32=", ";33=", ";34=", ";35=", ";36=", ";37=", ";38=", ";39=",
+		";40=", ";41=", ";42=", ";43=", ";44=", ";45=", ";46=", ";47=", ";48=", ";49=",
+		"=10", "=11", "=12", "=13", "=14", "=15",
+	};
+
+	constexpr std::size_t dictionary_size = sizeof(dictionary) / sizeof(dictionary[0]);
+	constexpr enet_uint8 token_base = 0x80;
+	constexpr enet_uint8 escape = 0xFF;
+
+	static_assert(dictionary_size <= escape - token_base, "Dictionary does not fit in the token range");
+
+	struct context_t
+	{
+		void* range_coder;
+		enet_uint8 scratch[ENET_PROTOCOL_MAXIMUM_MTU * 2];
+
+		// Optional, called after every packet with the sizes on both sides and the time it took
+		void (*observe)(bool compress, std::size_t raw, std::size_t packed, std::uint64_t ns);
+	};
+
+	inline std::size_t token_length(std::size_t token)
+	{
+		return std::strlen(codec::dictionary[token]);
+	}
+
+	inline std::size_t substitute(const ENetBuffer* buffers, std::size_t buffer_count, enet_uint8* out, std::size_t out_limit)
+	{
+		std::size_t written = 0;
+
+		// Tokens never span ENet's buffers, they split at command boundaries which the payloads sit inside
+		for (std::size_t b = 0; b < buffer_count; ++b)
+		{
+			auto data = (const enet_uint8*)buffers[b].data;
+			auto length = buffers[b].dataLength;
+
+			for (std::size_t i = 0; i < length;)
+			{
+				if (written + 2 > out_limit)
+				{
+					return 0;
+				}
+
+				std::size_t best = codec::dictionary_size, best_length = 1;
+
+				for (std::size_t token = 0; token < codec::dictionary_size; ++token)
+				{
+					auto candidate = codec::dictionary[token];
+
+					if (candidate[0] != (char)data[i])
+					{
+						continue;
+					}
+
+					auto candidate_length = codec::token_length(token);
+
+					if (candidate_length > best_length && candidate_length <= length - i && !std::memcmp(data + i, candidate, candidate_length))
+					{
+						best = token;
+						best_length = candidate_length;
+					}
+				}
+
+				if (best != codec::dictionary_size)
+				{
+					out[written++] = (enet_uint8)(codec::token_base + best);
+				}
+				else
+				{
+					if (data[i] >= codec::token_base)
+					{
+						out[written++] = codec::escape;
+					}
+
+					out[written++] = data[i];
+				}
+
+				i += best_length;
+			}
+		}
+
+		return written;
+	}
+
+	inline std::size_t expand(const enet_uint8* in, std::size_t in_length, enet_uint8* out, std::size_t out_limit)
+	{
+		std::size_t written = 0;
+
+		for (std::size_t i = 0; i < in_length; ++i)
+		{
+			auto byte = in[i];
+
+			if (byte == codec::escape)
+			{
+				if (++i >= in_length || written >= out_limit)
+				{
+					return 0;
+				}
+
+				out[written++] = in[i];
+			}
+			else if (byte >= codec::token_base)
+			{
+				auto token = (std::size_t)(byte - codec::token_base);
+
+				if (token >= codec::dictionary_size)
+				{
+					return 0;
+				}
+
+				auto length = codec::token_length(token);
+
+				if (written + length > out_limit)
+				{
+					return 0;
+				}
+
+				std::memcpy(out + written, codec::dictionary[token], length);
+				written += length;
+			}
+			else
+			{
+				if (written >= out_limit)
+				{
+					return 0;
+				}
+
+				out[written++] = byte;
+			}
+		}
+
+		return written;
+	}
+
+	inline size_t ENET_CALLBACK compress(void* context, const ENetBuffer* in_buffers, size_t in_buffer_count, size_t in_limit, enet_uint8* out_data, size_t out_limit)
+	{
+		auto codec = (context_t*)context;
+		auto start = std::chrono::steady_clock::now();
+
+		ENetBuffer substituted;
+		substituted.data = codec->scratch;
+		substituted.dataLength = codec::substitute(in_buffers, in_buffer_count, codec->scratch, sizeof(codec->scratch));
+
+		size_t packed = 0;
+
+		if (substituted.dataLength)
+		{
+			packed = enet_range_coder_compress(codec->range_coder, &substituted, 1, substituted.dataLength, out_data, out_limit);
+		}
+
+		if (codec->observe)
+		{
+			codec->observe(true, in_limit, packed ? packed : in_limit, (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		return packed;
+	}
+
+	inline size_t ENET_CALLBACK decompress(void* context, const enet_uint8* in_data, size_t in_limit, enet_uint8* out_data, size_t out_limit)
+	{
+		auto codec = (context_t*)context;
+		auto start = std::chrono::steady_clock::now();
+
+		auto substituted = enet_range_coder_decompress(codec->range_coder, in_data, in_limit, codec->scratch, sizeof(codec->scratch));
+		auto raw = substituted ? codec::expand(codec->scratch, substituted, out_data, out_limit) : 0;
+
+		if (codec->observe && raw)
+		{
+			codec->observe(false, raw, in_limit, (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		return raw;
+	}
+
+	inline void ENET_CALLBACK destroy(void* context)
+	{
+		auto codec = (context_t*)context;
+		enet_range_coder_destroy(codec->range_coder);
+		delete codec;
+	}
+
+	// The host takes ownership of the context and frees it on enet_host_destroy
+	inline bool enable(ENetHost* host, void (*observe)(bool, std::size_t, std::size_t, std::uint64_t) = nullptr)
+	{
+		auto codec = new context_t();
+		codec->range_coder = enet_range_coder_create();
+		codec->observe = observe;
+
+		if (!codec->range_coder)
+		{
+			delete codec;
+			return false;
+		}
+
+		ENetCompressor compressor;
+		compressor.context = codec;
+		compressor.compress = codec::compress;
+		compressor.decompress = codec::decompress;
+		compressor.destroy = codec::destroy;
+		enet_host_compress(host, &compressor);
+		return true;
+	}
+}
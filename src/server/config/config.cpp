@@ -0,0 +1,300 @@
+#include "config.hpp"
+#include "logger/logger.hpp"
+
+#include <fstream>
+#include <unordered_map>
+
+int config::port = 23363;
+int config::max_peers = 16;
+int config::initial_peers = 16;
+int config::max_rooms = 6;
+int config::max_name_length = 12;
+int config::metrics_interval = 0;
+int config::http_port = 0;
+int config::stats_segment = 0;
+int config::trace = 0;
+int config::trace_buffer = 65536;
+int config::recorder_events = 16384;
+std::string config::capture;
+std::string config::replay;
+int config::replay_speed = 0;
+std::string config::binary_log;
+int config::log_console = 1;
+int config::log_level = 0;
+int config::log_burst_debug = 100;
+int config::log_sample_debug = 100;
+int config::log_burst_info = 50;
+int config::log_sample_info = 100;
+int config::log_burst_warning = 20;
+int config::log_sample_warning = 100;
+int config::log_burst_error = 20;
+int config::log_sample_error = 100;
+int config::rate_limit = 0;
+int config::peer_rate = 50;
+int config::peer_burst = 100;
+int config::lobby_rate = 10;
+int config::lobby_burst = 20;
+int config::gameplay_rate = 30;
+int config::gameplay_burst = 60;
+int config::other_rate = 5;
+int config::other_burst = 10;
+int config::rate_limit_strikes = 50;
+int config::peer_queue_soft = 16384;
+int config::peer_queue_hard = 262144;
+int config::slow_peer_grace = 10000;
+int config::host_incoming_bandwidth = 0;
+int config::host_outgoing_bandwidth = 0;
+int config::throttle_interval = 5000;
+int config::loss_high = 5;
+int config::loss_low = 2;
+int config::peer_timeout_limit = 8;
+int config::peer_timeout_min = 2000;
+int config::peer_timeout_max = 10000;
+int config::room_bandwidth = 0;
+int config::compression = 0;
+int config::compressed_port = 0;
+int config::match_start_bundle = 0;
+int config::start_lead = 500;
+int config::room_capacity = 16;
+int config::rtt_band_width = 40;
+int config::rtt_bands = 6;
+int config::matchmake_widen = 1000;
+int config::matchmake_wait = 3000;
+int config::room_list_page = 25;
+int config::room_list_refresh = 250;
+int config::roster_deltas = 0;
+int config::roster_interval = 100;
+
+namespace
+{
+	const std::unordered_map<std::string, int*> options =
+	{
+		{ "port", &config::port },
+		{ "max_peers", &config::max_peers },
+		{ "initial_peers", &config::initial_peers },
+		{ "max_rooms", &config::max_rooms },
+		{ "max_name_length", &config::max_name_length },
+		{ "metrics_interval", &config::metrics_interval },
+		{ "http_port", &config::http_port },
+		{ "stats_segment", &config::stats_segment },
+		{ "trace", &config::trace },
+		{ "trace_buffer", &config::trace_buffer },
+		{ "recorder_events", &config::recorder_events },
+		{ "replay_speed", &config::replay_speed },
+		{ "log_console", &config::log_console },
+		{ "log_level", &config::log_level },
+		{ "log_burst_debug", &config::log_burst_debug },
+		{ "log_sample_debug", &config::log_sample_debug },
+		{ "log_burst_info", &config::log_burst_info },
+		{ "log_sample_info", &config::log_sample_info },
+		{ "log_burst_warning", &config::log_burst_warning },
+		{ "log_sample_warning", &config::log_sample_warning },
+		{ "log_burst_error", &config::log_burst_error },
+		{ "log_sample_error", &config::log_sample_error },
+		{ "rate_limit", &config::rate_limit },
+		{ "peer_rate", &config::peer_rate },
+		{ "peer_burst", &config::peer_burst },
+		{ "lobby_rate", &config::lobby_rate },
+		{ "lobby_burst", &config::lobby_burst },
+		{ "gameplay_rate", &config::gameplay_rate },
+		{ "gameplay_burst", &config::gameplay_burst },
+		{ "other_rate", &config::other_rate },
+		{ "other_burst", &config::other_burst },
+		{ "rate_limit_strikes", &config::rate_limit_strikes },
+		{ "peer_queue_soft", &config::peer_queue_soft },
+		{ "peer_queue_hard", &config::peer_queue_hard },
+		{ "slow_peer_grace", &config::slow_peer_grace },
+		{ "host_incoming_bandwidth", &config::host_incoming_bandwidth },
+		{ "host_outgoing_bandwidth", &config::host_outgoing_bandwidth },
+		{ "throttle_interval", &config::throttle_interval },
+		{ "loss_high", &config::loss_high },
+		{ "loss_low", &config::loss_low },
+		{ "peer_timeout_limit", &config::peer_timeout_limit },
+		{ "peer_timeout_min", &config::peer_timeout_min },
+		{ "peer_timeout_max", &config::peer_timeout_max },
+		{ "room_bandwidth", &config::room_bandwidth },
+		{ "compression", &config::compression },
+		{ "compressed_port", &config::compressed_port },
+		{ "match_start_bundle", &config::match_start_bundle },
+		{ "start_lead", &config::start_lead },
+		{ "room_capacity", &config::room_capacity },
+		{ "rtt_band_width", &config::rtt_band_width },
+		{ "rtt_bands", &config::rtt_bands },
+		{ "matchmake_widen", &config::matchmake_widen },
+		{ "matchmake_wait", &config::matchmake_wait },
+		{ "room_list_page", &config::room_list_page },
+		{ "room_list_refresh", &config::room_list_refresh },
+		{ "roster_deltas", &config::roster_deltas },
+		{ "roster_interval", &config::roster_interval },
+	};
+
+	const std::unordered_map<std::string, std::string*> string_options =
+	{
+		{ "capture", &config::capture },
+		{ "replay", &config::replay },
+		{ "binary_log", &config::binary_log },
+	};
+}
+
+void config::init(int argc, char* argv[])
+{
+	std::string path = "server.cfg";
+
+	for (auto i = 1; i < argc - 1; ++i)
+	{
+		if (std::string(argv[i]) == "-config")
+		{
+			path = argv[i + 1];
+		}
+	}
+
+	// Later sources win: file, then environment, then command line
+	config::load_file(path);
+	config::load_environment();
+	config::load_arguments(argc, argv);
+
+	// ENet caps a single host at 4095 peers
+	config::max_peers = std::clamp(config::max_peers, 1, 4095);
+	config::initial_peers = std::clamp(config::initial_peers, 1, config::max_peers);
+	config::max_name_length = std::max(1, config::max_name_length);
+	config::room_capacity = std::max(1, config::room_capacity);
+	config::rtt_band_width = std::max(1, config::rtt_band_width);
+	config::rtt_bands = std::max(1, config::rtt_bands);
+	config::matchmake_widen = std::max(1, config::matchmake_widen);
+	config::room_list_page = std::max(1, config::room_list_page);
+	config::log_level = std::clamp(config::log_level, 0, 3);
+	config::peer_queue_hard = std::max(config::peer_queue_hard, config::peer_queue_soft);
+	config::throttle_interval = std::max(250, config::throttle_interval);
+	config::loss_low = std::min(config::loss_low, config::loss_high);
+	config::peer_timeout_limit = std::max(1, config::peer_timeout_limit);
+	config::peer_timeout_max = std::max(config::peer_timeout_max, config::peer_timeout_min);
+
+	PRINT_INFO("Capacity: %i peers (%i active), %i rooms", config::max_peers, config::initial_peers, config::max_rooms);
+}
+
+void config::load_file(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	PRINT_INFO("Loading config \"%s\"", path.c_str());
+
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		auto split_line = logger::split(line, "=");
+
+		if (split_line.size() != 2 || !config::set(split_line[0], split_line[1]))
+		{
+			PRINT_WARNING("Ignoring config line \"%s\"", line.c_str());
+		}
+	}
+}
+
+void config::load_environment()
+{
+	std::vector<std::string> keys;
+
+	for (auto& option : options)
+	{
+		keys.emplace_back(option.first);
+	}
+
+	for (auto& option : string_options)
+	{
+		keys.emplace_back(option.first);
+	}
+
+	for (auto& key : keys)
+	{
+		std::string name = "PEGROYALE_" + key;
+
+		std::for_each(name.begin(), name.end(), ([](char& c)
+		{
+			c = std::toupper(c);
+		}));
+
+		if (auto value = std::getenv(name.c_str()))
+		{
+			config::set(key, value);
+		}
+	}
+}
+
+void config::load_arguments(int argc, char* argv[])
+{
+	for (auto i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-config")
+		{
+			++i;
+			continue;
+		}
+
+		if (arg.size() < 2 || arg[0] != '-')
+		{
+			PRINT_WARNING("Ignoring argument \"%s\"", arg.c_str());
+			continue;
+		}
+
+		auto key = arg.substr(1);
+
+		// Options given without a value are switches
+		if (i + 1 < argc && argv[i + 1][0] != '-')
+		{
+			config::set(key, argv[++i]);
+		}
+		else
+		{
+			config::set(key, "1");
+		}
+	}
+}
+
+bool config::set(const std::string& key, const std::string& value)
+{
+	auto string_option = string_options.find(key);
+
+	if (string_option != string_options.end())
+	{
+		*string_option->second = value;
+		return true;
+	}
+
+	auto option = options.find(key);
+
+	if (option == options.end())
+	{
+		PRINT_WARNING("Unknown config option \"%s\"", key.c_str());
+		return false;
+	}
+
+	try
+	{
+		*option->second = std::stoi(value);
+	}
+	catch (...)
+	{
+		PRINT_WARNING("Invalid value \"%s\" for config option \"%s\"", value.c_str(), key.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+class config final
+{
+public:
+	static void init(int argc, char* argv[]);
+
+	static int port;
+	static int max_peers;
+	static int initial_peers;
+	static int max_rooms;
+	static int max_name_length;
+	static int metrics_interval;
+	static int http_port;
+	static int stats_segment;
+	static int trace;
+	static int trace_buffer;
+	static int recorder_events;
+	static std::string capture;
+	static std::string replay;
+	static int replay_speed;
+	static std::string binary_log;
+	static int log_console;
+	static int log_level;
+	static int log_burst_debug;
+	static int log_sample_debug;
+	static int log_burst_info;
+	static int log_sample_info;
+	static int log_burst_warning;
+	static int log_sample_warning;
+	static int log_burst_error;
+	static int log_sample_error;
+	static int rate_limit;
+	static int peer_rate;
+	static int peer_burst;
+	static int lobby_rate;
+	static int lobby_burst;
+	static int gameplay_rate;
+	static int gameplay_burst;
+	static int other_rate;
+	static int other_burst;
+	static int rate_limit_strikes;
+	static int peer_queue_soft;
+	static int peer_queue_hard;
+	static int slow_peer_grace;
+	static int host_incoming_bandwidth;
+	static int host_outgoing_bandwidth;
+	static int throttle_interval;
+	static int loss_high;
+	static int loss_low;
+	static int peer_timeout_limit;
+	static int peer_timeout_min;
+	static int peer_timeout_max;
+	static int room_bandwidth;
+	static int compression;
+	static int compressed_port;
+	static int match_start_bundle;
+	static int start_lead;
+	static int room_capacity;
+	static int rtt_band_width;
+	static int rtt_bands;
+	static int matchmake_widen;
+	static int matchmake_wait;
+	static int room_list_page;
+	static int room_list_refresh;
+	static int roster_deltas;
+	static int roster_interval;
+
+private:
+	static void load_file(const std::string& path);
+	static void load_environment();
+	static void load_arguments(int argc, char* argv[]);
+	static bool set(const std::string& key, const std::string& value);
+};
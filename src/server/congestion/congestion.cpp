@@ -0,0 +1,198 @@
+#include "congestion.hpp"
+#include "logger/logger.hpp"
+#include "networking/networking.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "recorder/recorder.hpp"
+
+std::chrono::steady_clock::time_point congestion::last_update;
+
+peer_queue_t::~peer_queue_t()
+{
+	for (auto& pending : this->pending)
+	{
+		--pending.second->referenceCount;
+		congestion::release(pending.second);
+	}
+}
+
+void congestion::send(ENetPeer* peer, peer_queue_t& queue, proto_t proto, ENetPacket* packet)
+{
+	if (queue.queued_bytes >= (std::size_t)config::peer_queue_soft)
+	{
+		switch (congestion::get_delivery(proto))
+		{
+			case delivery_t::LATEST:
+			{
+				metrics::record_congestion(congestion_action_t::COALESCED);
+
+				// ENet frees a packet once its last queued copy is acknowledged, so hold a reference of our own
+				++packet->referenceCount;
+
+				for (auto& pending : queue.pending)
+				{
+					if (pending.first == proto)
+					{
+						--pending.second->referenceCount;
+						congestion::release(pending.second);
+						pending.second = packet;
+						return;
+					}
+				}
+
+				queue.pending.emplace_back(proto, packet);
+				return;
+			}
+
+			case delivery_t::BEST_EFFORT:
+			{
+				// Unreliable commands are never retransmitted and ENet's throttle sheds them first.
+				// The packet can be shared with healthy peers, so this one gets a copy of its own
+				metrics::record_congestion(congestion_action_t::DOWNGRADED);
+
+				if (packet->flags & ENET_PACKET_FLAG_RELIABLE)
+				{
+					auto unreliable = enet_packet_create(packet->data, packet->dataLength, packet->flags & ~ENET_PACKET_FLAG_RELIABLE);
+
+					if (congestion::queue_packet(peer, unreliable))
+					{
+						queue.queued_bytes += unreliable->dataLength;
+					}
+
+					congestion::release(unreliable);
+					return;
+				}
+			} break;
+		}
+	}
+
+	if (congestion::queue_packet(peer, packet))
+	{
+		queue.queued_bytes += packet->dataLength;
+	}
+}
+
+void congestion::update()
+{
+	auto now = networking::event_time;
+
+	// Walking every peer's command list is cheap but pointless on every loop iteration
+	if (now - congestion::last_update < std::chrono::milliseconds(100))
+	{
+		return;
+	}
+
+	congestion::last_update = now;
+
+	for (auto host : networking::hosts)
+	{
+		for (auto i = 0u; i < host->peerCount; ++i)
+		{
+			auto peer = &host->peers[i];
+
+			if (peer->state != ENET_PEER_STATE_CONNECTED || !peer->data)
+			{
+				continue;
+			}
+
+			auto& queue = networking::get_state(peer)->queue;
+			queue.queued_bytes = congestion::sample(peer);
+
+			if (queue.queued_bytes >= (std::size_t)config::peer_queue_hard)
+			{
+				PRINT_WARNING("Dropping %s, %u bytes queued", networking::get_ip(peer->address).c_str(), (unsigned)queue.queued_bytes);
+				congestion::drop_peer(peer);
+				continue;
+			}
+
+			if (queue.queued_bytes >= (std::size_t)config::peer_queue_soft)
+			{
+				if (!queue.congested)
+				{
+					queue.congested = true;
+					queue.congested_since = now;
+				}
+				else if (config::slow_peer_grace > 0 && now - queue.congested_since >= std::chrono::milliseconds(config::slow_peer_grace))
+				{
+					PRINT_WARNING("Dropping %s, backed up for over %i ms", networking::get_ip(peer->address).c_str(), config::slow_peer_grace);
+					congestion::drop_peer(peer);
+				}
+
+				continue;
+			}
+
+			queue.congested = false;
+			congestion::flush_pending(peer, queue);
+		}
+	}
+}
+
+delivery_t congestion::get_delivery(proto_t proto)
+{
+	switch (proto)
+	{
+		case proto_t::GET_USER_LIST:
+			return delivery_t::LATEST;
+
+		case proto_t::CHECK_SERVER_ALIVE:
+			return delivery_t::BEST_EFFORT;
+	}
+
+	return delivery_t::CRITICAL;
+}
+
+std::size_t congestion::sample(ENetPeer* peer)
+{
+	// Everything acknowledged is gone from both, so this is exactly what ENet still holds for the peer
+	std::size_t queued = peer->reliableDataInTransit;
+
+	for (auto node = enet_list_begin(&peer->outgoingCommands); node != enet_list_end(&peer->outgoingCommands); node = enet_list_next(node))
+	{
+		queued += ((ENetOutgoingCommand*)node)->fragmentLength;
+	}
+
+	return queued;
+}
+
+void congestion::flush_pending(ENetPeer* peer, peer_queue_t& queue)
+{
+	for (auto& pending : queue.pending)
+	{
+		if (congestion::queue_packet(peer, pending.second))
+		{
+			queue.queued_bytes += pending.second->dataLength;
+		}
+
+		--pending.second->referenceCount;
+		congestion::release(pending.second);
+	}
+
+	queue.pending.clear();
+}
+
+void congestion::release(ENetPacket* packet)
+{
+	if (packet->referenceCount == 0)
+	{
+		enet_packet_destroy(packet);
+	}
+}
+
+void congestion::drop_peer(ENetPeer* peer)
+{
+	metrics::record_congestion(congestion_action_t::DISCONNECTED);
+
+	// Run the normal disconnect path first so the room hears about it, then throw away
+	// everything ENet still holds for the peer instead of waiting on a link that is not draining
+	ENetEvent evt{};
+	evt.type = ENET_EVENT_TYPE_DISCONNECT;
+	evt.peer = peer;
+	networking::dispatch_event(evt);
+
+	enet_peer_disconnect_now(peer, 0);
+}
+
+bool congestion::queue_packet(ENetPeer* peer, ENetPacket* packet)
+{
+	return enet_peer_send(peer, 0, packet) >= 0;
+}
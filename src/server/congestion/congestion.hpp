@@ -0,0 +1,55 @@
+#pragma once
+
+enum class proto_t;
+
+enum class delivery_t : std::uint8_t
+{
+	// Must arrive, in order, whatever the cost
+	CRITICAL,
+	// Only the newest copy matters, older ones can be replaced while the peer is backed up
+	LATEST,
+	// Fine to lose when the peer is backed up
+	BEST_EFFORT,
+};
+
+enum class congestion_action_t : std::uint8_t
+{
+	COALESCED,
+	DOWNGRADED,
+	DISCONNECTED,
+	COUNT,
+};
+
+struct peer_queue_t
+{
+	// Last sampled from ENet plus everything handed to it since
+	std::size_t queued_bytes = 0;
+	std::chrono::steady_clock::time_point congested_since;
+	bool congested = false;
+
+	// Held back LATEST packets, at most one per proto, each holding a reference
+	std::vector<std::pair<proto_t, ENetPacket*>> pending;
+
+	~peer_queue_t();
+};
+
+// Keeps what a single peer can make the server hold on to bounded. Between the soft and hard
+// limits updates are coalesced or downgraded, past the hard limit or after staying congested
+// too long the peer is dropped so it stops costing the rest of the room
+class congestion final
+{
+public:
+	// Never takes ownership, packets may be shared between peers and the caller releases them
+	static void send(ENetPeer* peer, peer_queue_t& queue, proto_t proto, ENetPacket* packet);
+	static void release(ENetPacket* packet);
+	static void update();
+	static delivery_t get_delivery(proto_t proto);
+
+private:
+	static std::size_t sample(ENetPeer* peer);
+	static void flush_pending(ENetPeer* peer, peer_queue_t& queue);
+	static void drop_peer(ENetPeer* peer);
+	static bool queue_packet(ENetPeer* peer, ENetPacket* packet);
+
+	static std::chrono::steady_clock::time_point last_update;
+};
@@ -0,0 +1,284 @@
+#include "http.hpp"
+#include "logger/logger.hpp"
+#include "global/global.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "networking/networking.hpp"
+
+std::shared_ptr<const status_snapshot_t> http::status;
+std::unique_ptr<httplib::Server> http::server;
+std::thread http::thread;
+std::chrono::steady_clock::time_point http::last_publish;
+
+void http::init()
+{
+	if (config::http_port <= 0)
+	{
+		return;
+	}
+
+	http::publish();
+
+	http::server = std::make_unique<httplib::Server>();
+
+	http::server->Get("/healthz", [](const httplib::Request&, httplib::Response& res)
+	{
+		auto status = std::atomic_load(&http::status);
+
+		// The game thread publishes every second, a stale snapshot means it has stopped turning over
+		if (std::chrono::steady_clock::now() - status->published > 5s)
+		{
+			res.status = 503;
+			res.set_content("stalled\n", "text/plain");
+			return;
+		}
+
+		res.set_content("ok\n", "text/plain");
+	});
+
+	http::server->Get("/readyz", [](const httplib::Request&, httplib::Response& res)
+	{
+		auto status = std::atomic_load(&http::status);
+
+		if (!status->ready)
+		{
+			res.status = 503;
+			res.set_content("not ready\n", "text/plain");
+			return;
+		}
+
+		res.set_content("ready\n", "text/plain");
+	});
+
+	http::server->Get("/metrics", [](const httplib::Request&, httplib::Response& res)
+	{
+		res.set_content(http::render_metrics(*std::atomic_load(&http::status)), "text/plain; version=0.0.4");
+	});
+
+	http::thread = std::thread([]()
+	{
+		if (!http::server->listen("127.0.0.1", config::http_port))
+		{
+			PRINT_ERROR("Unable to start metrics endpoint on port %i", config::http_port);
+		}
+	});
+
+	PRINT_INFO("Metrics endpoint listening on 127.0.0.1:%i", config::http_port);
+}
+
+void http::publish()
+{
+	if (config::http_port <= 0)
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (http::status && now - http::last_publish < 1s)
+	{
+		return;
+	}
+
+	http::last_publish = now;
+
+	auto status = std::make_shared<status_snapshot_t>();
+	status->published = now;
+	status->rooms = networking::rooms.size();
+
+	for (auto& room : networking::rooms)
+	{
+		status->players += room.players.size();
+		status->matches += room.playing;
+	}
+
+	status->queued = matchmaker::queued();
+	status->bytes_sent = networking::bytes_sent;
+	status->bytes_received = networking::bytes_received;
+	status->packets_sent = networking::packets_sent;
+	status->packets_received = networking::packets_received;
+
+	for (auto host : networking::hosts)
+	{
+		status->connected_peers += host->connectedPeers;
+		status->peer_capacity += config::max_peers;
+
+		for (auto i = 0u; i < host->peerCount; ++i)
+		{
+			auto& peer = host->peers[i];
+
+			if (peer.state != ENET_PEER_STATE_CONNECTED)
+			{
+				continue;
+			}
+
+			auto outgoing = (std::uint64_t)enet_list_size(&peer.outgoingCommands);
+
+			status->peer_rtt.emplace_back(peer.roundTripTime);
+			status->outgoing_commands += outgoing;
+			status->outgoing_commands_max = std::max(status->outgoing_commands_max, outgoing);
+			status->waiting_data += peer.totalWaitingData;
+			status->reliable_in_transit += peer.reliableDataInTransit;
+		}
+	}
+
+	status->ready = !global::shutdown && !networking::hosts.empty() && status->connected_peers < status->peer_capacity;
+
+	std::atomic_store(&http::status, std::shared_ptr<const status_snapshot_t>(std::move(status)));
+}
+
+void http::cleanup()
+{
+	if (!http::server)
+	{
+		return;
+	}
+
+	http::server->stop();
+
+	if (http::thread.joinable())
+	{
+		http::thread.join();
+	}
+
+	http::server.reset();
+}
+
+std::string http::render_metrics(const status_snapshot_t& status)
+{
+	std::string result;
+
+	auto gauge = [&](const char* name, const char* help, std::uint64_t value)
+	{
+		FORMAT_APPEND(result, "# HELP pegroyale_%s %s\n# TYPE pegroyale_%s gauge\npegroyale_%s %llu\n", name, help, name, name, value);
+	};
+
+	auto counter = [&](const char* name, const char* help, std::uint64_t value)
+	{
+		FORMAT_APPEND(result, "# HELP pegroyale_%s %s\n# TYPE pegroyale_%s counter\npegroyale_%s %llu\n", name, help, name, name, value);
+	};
+
+	gauge("rooms", "Rooms currently open", status.rooms);
+	gauge("players", "Players currently in a room", status.players);
+	gauge("matches_in_progress", "Rooms currently playing a match", status.matches);
+	gauge("matchmaking_queued", "Players waiting in the matchmaking queue", status.queued);
+	gauge("connected_peers", "Connected ENet peers", status.connected_peers);
+	gauge("peer_capacity", "Peer slots across all hosts", status.peer_capacity);
+	counter("sent_bytes_total", "Bytes sent by all ENet hosts", status.bytes_sent);
+	counter("received_bytes_total", "Bytes received by all ENet hosts", status.bytes_received);
+	counter("sent_datagrams_total", "UDP datagrams sent by all ENet hosts", status.packets_sent);
+	counter("received_datagrams_total", "UDP datagrams received by all ENet hosts", status.packets_received);
+	gauge("outgoing_commands", "Commands queued for sending across all peers", status.outgoing_commands);
+	gauge("outgoing_commands_max", "Longest outgoing command queue of any peer", status.outgoing_commands_max);
+	gauge("waiting_data_bytes", "Received data waiting to be dispatched across all peers", status.waiting_data);
+	gauge("reliable_in_transit_bytes", "Unacknowledged reliable data across all peers", status.reliable_in_transit);
+
+	static const std::uint32_t rtt_bounds[] = { 10, 25, 50, 100, 150, 250, 500, 1000 };
+	std::uint64_t rtt_sum = 0;
+
+	for (auto rtt : status.peer_rtt)
+	{
+		rtt_sum += rtt;
+	}
+
+	result.append("# HELP pegroyale_peer_rtt_ms Round trip time of connected peers\n# TYPE pegroyale_peer_rtt_ms histogram\n");
+
+	for (auto bound : rtt_bounds)
+	{
+		auto below = std::count_if(status.peer_rtt.begin(), status.peer_rtt.end(), [&](std::uint32_t rtt) { return rtt <= bound; });
+		FORMAT_APPEND(result, "pegroyale_peer_rtt_ms_bucket{le=\"%u\"} %llu\n", bound, (std::uint64_t)below);
+	}
+
+	FORMAT_APPEND(result, "pegroyale_peer_rtt_ms_bucket{le=\"+Inf\"} %llu\n", (std::uint64_t)status.peer_rtt.size());
+	FORMAT_APPEND(result, "pegroyale_peer_rtt_ms_sum %llu\npegroyale_peer_rtt_ms_count %llu\n", rtt_sum, (std::uint64_t)status.peer_rtt.size());
+
+	// Per-proto counters come straight from the per-thread blocks, which are safe to read from here
+	auto stats = metrics::snapshot();
+	static const std::vector<std::uint64_t> ns_bounds = { 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000 };
+
+	// Player facing waits and spreads run from milliseconds to seconds
+	static const std::vector<std::uint64_t> ms_bounds = { 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000 };
+
+	auto histogram = [&](const char* name, const std::string& label, const histogram_t& values, const std::vector<std::uint64_t>& bounds)
+	{
+		auto prefix = label.empty() ? label : label + ",";
+		auto labels = label.empty() ? label : "{" + label + "}";
+
+		for (auto bound : bounds)
+		{
+			FORMAT_APPEND(result, "pegroyale_%s_seconds_bucket{%sle=\"%g\"} %llu\n", name, prefix.c_str(), bound / 1e9, values.count_below(bound));
+		}
+
+		FORMAT_APPEND(result, "pegroyale_%s_seconds_bucket{%sle=\"+Inf\"} %llu\n", name, prefix.c_str(), values.count);
+		FORMAT_APPEND(result, "pegroyale_%s_seconds_sum%s %g\n", name, labels.c_str(), values.total / 1e9);
+		FORMAT_APPEND(result, "pegroyale_%s_seconds_count%s %llu\n", name, labels.c_str(), values.count);
+	};
+
+	result.append("# HELP pegroyale_tick_seconds Time spent handling events per loop iteration\n# TYPE pegroyale_tick_seconds histogram\n");
+	histogram("tick", "", stats.tick_ns, ns_bounds);
+
+	result.append("# HELP pegroyale_start_skew_seconds Spread between the first and last player starting a match, as acknowledged by the clients\n# TYPE pegroyale_start_skew_seconds histogram\n");
+	histogram("start_skew", "", stats.start_skew_ns, ms_bounds);
+
+	result.append("# HELP pegroyale_matchmake_wait_seconds Time players spent in the matchmaking queue before being seated\n# TYPE pegroyale_matchmake_wait_seconds histogram\n");
+	histogram("matchmake_wait", "", stats.matchmake_wait_ns, ms_bounds);
+
+	result.append("# HELP pegroyale_room_rtt_spread_seconds Difference between the highest and lowest player RTT in a room starting a match\n# TYPE pegroyale_room_rtt_spread_seconds histogram\n");
+	histogram("room_rtt_spread", "", stats.room_rtt_spread_ns, ms_bounds);
+
+	counter("parse_failures_total", "Packets dropped because the proto field could not be read", stats.parse_failures);
+	counter("rate_limited_bytes_total", "Bytes dropped by per peer rate limits", stats.rate_limited_bytes);
+	counter("rate_limit_disconnects_total", "Peers disconnected for repeatedly exceeding rate limits", stats.rate_limit_disconnects);
+
+	counter("slow_peer_coalesced_total", "Updates to backed up peers replaced by a newer copy", stats.congestion[(int)congestion_action_t::COALESCED]);
+	counter("slow_peer_downgraded_total", "Updates to backed up peers sent unreliably", stats.congestion[(int)congestion_action_t::DOWNGRADED]);
+	counter("slow_peer_disconnects_total", "Peers dropped for letting their outgoing queue grow too large", stats.congestion[(int)congestion_action_t::DISCONNECTED]);
+
+	counter("compressed_datagrams_total", "Datagrams offered to the compressor on the compressed port", stats.compressed.packets);
+	counter("compressed_raw_bytes_total", "Bytes offered to the compressor", stats.compressed.raw_bytes);
+	counter("compressed_packed_bytes_total", "Bytes sent after compression, uncompressible datagrams count at their raw size", stats.compressed.packed_bytes);
+	counter("decompressed_datagrams_total", "Datagrams decompressed on the compressed port", stats.decompressed.packets);
+	counter("decompressed_raw_bytes_total", "Bytes produced by decompression", stats.decompressed.raw_bytes);
+	counter("decompressed_packed_bytes_total", "Compressed bytes received", stats.decompressed.packed_bytes);
+
+	result.append("# HELP pegroyale_compress_seconds Time spent compressing one datagram\n# TYPE pegroyale_compress_seconds histogram\n");
+	histogram("compress", "", stats.compressed.ns, ns_bounds);
+	result.append("# HELP pegroyale_decompress_seconds Time spent decompressing one datagram\n# TYPE pegroyale_decompress_seconds histogram\n");
+	histogram("decompress", "", stats.decompressed.ns, ns_bounds);
+
+	counter("room_over_budget_total", "Room broadcasts sent after the room spent its bandwidth budget", stats.room_over_budget);
+	counter("room_over_budget_bytes_total", "Bytes broadcast after the room spent its bandwidth budget", stats.room_over_budget_bytes);
+
+	result.append("# HELP pegroyale_rate_limited_total Packets dropped by per peer rate limits\n# TYPE pegroyale_rate_limited_total counter\n");
+
+	for (auto i = 0u; i < stats.rate_limited.size(); ++i)
+	{
+		FORMAT_APPEND(result, "pegroyale_rate_limited_total{class=\"%s\"} %llu\n", limiter::get_class_name((message_class_t)i), stats.rate_limited[i]);
+	}
+
+	result.append("# HELP pegroyale_messages_total Messages handled per proto\n# TYPE pegroyale_messages_total counter\n");
+	result.append("# HELP pegroyale_message_bytes_in_total Payload bytes received per proto\n# TYPE pegroyale_message_bytes_in_total counter\n");
+	result.append("# HELP pegroyale_message_bytes_out_total Payload bytes sent per proto\n# TYPE pegroyale_message_bytes_out_total counter\n");
+	result.append("# HELP pegroyale_broadcast_fanout_total Recipients of room broadcasts per proto\n# TYPE pegroyale_broadcast_fanout_total counter\n");
+	result.append("# HELP pegroyale_handler_seconds Handler time per proto\n# TYPE pegroyale_handler_seconds histogram\n");
+
+	for (auto i = 0; i < metrics::proto_slots; ++i)
+	{
+		auto& proto = stats.protos[i];
+
+		if (!proto.count && !proto.packets_out)
+		{
+			continue;
+		}
+
+		auto label = FORMAT_VA("proto=\"%s\"", i ? networking::get_proto_name((proto_t)(i - 1)) : "UNKNOWN");
+
+		FORMAT_APPEND(result, "pegroyale_messages_total{%s} %llu\n", label.c_str(), proto.count);
+		FORMAT_APPEND(result, "pegroyale_message_bytes_in_total{%s} %llu\n", label.c_str(), proto.bytes_in);
+		FORMAT_APPEND(result, "pegroyale_message_bytes_out_total{%s} %llu\n", label.c_str(), proto.bytes_out);
+		FORMAT_APPEND(result, "pegroyale_broadcast_fanout_total{%s} %llu\n", label.c_str(), proto.fanout);
+		histogram("handler", label, proto.handler_ns, ns_bounds);
+	}
+
+	return result;
+}
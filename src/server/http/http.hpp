@@ -0,0 +1,43 @@
+#pragma once
+
+struct status_snapshot_t
+{
+	std::chrono::steady_clock::time_point published;
+	bool ready = false;
+
+	std::uint64_t rooms = 0;
+	std::uint64_t players = 0;
+	std::uint64_t matches = 0;
+	std::uint64_t queued = 0;
+	std::uint64_t connected_peers = 0;
+	std::uint64_t peer_capacity = 0;
+
+	std::uint64_t bytes_sent = 0;
+	std::uint64_t bytes_received = 0;
+	std::uint64_t packets_sent = 0;
+	std::uint64_t packets_received = 0;
+
+	std::vector<std::uint32_t> peer_rtt;
+	std::uint64_t outgoing_commands = 0;
+	std::uint64_t outgoing_commands_max = 0;
+	std::uint64_t waiting_data = 0;
+	std::uint64_t reliable_in_transit = 0;
+};
+
+class http final
+{
+public:
+	static void init();
+	static void publish();
+	static void cleanup();
+
+private:
+	static std::string render_metrics(const status_snapshot_t& status);
+
+	// Swapped in whole by the game thread and only ever read by the HTTP thread,
+	// so a scrape never touches live room or peer state
+	static std::shared_ptr<const status_snapshot_t> status;
+	static std::unique_ptr<httplib::Server> server;
+	static std::thread thread;
+	static std::chrono::steady_clock::time_point last_publish;
+};
@@ -0,0 +1,119 @@
+#include "limiter.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "recorder/recorder.hpp"
+
+bool token_bucket_t::take(double rate, double burst, std::chrono::steady_clock::time_point now, double cost)
+{
+	auto elapsed = std::chrono::duration<double>(now - this->last).count();
+	this->last = now;
+	this->tokens = std::min(burst, this->tokens + elapsed * rate);
+
+	if (this->tokens < cost)
+	{
+		return false;
+	}
+
+	this->tokens -= cost;
+	return true;
+}
+
+bool limiter::admit(ENetPeer* peer, peer_limits_t& limits, const ENetPacket* packet)
+{
+	if (!config::rate_limit)
+	{
+		return true;
+	}
+
+	auto now = networking::event_time;
+	auto type = limiter::classify(packet);
+
+	static const int* class_limits[][2] =
+	{
+		{ &config::lobby_rate, &config::lobby_burst },
+		{ &config::gameplay_rate, &config::gameplay_burst },
+		{ &config::other_rate, &config::other_burst },
+	};
+
+	auto& rate = class_limits[(int)type];
+
+	// The peer bucket is only charged for packets its class would have let through
+	if (limits.classes[(int)type].take(*rate[0], *rate[1], now) && limits.packets.take(config::peer_rate, config::peer_burst, now))
+	{
+		return true;
+	}
+
+	metrics::record_rate_limited(type, packet->dataLength);
+	recorder::record(recorder_event_t::RATE_LIMITED, peer, proto_t::NONE, -1, (std::uint32_t)type);
+
+	if (config::rate_limit_strikes > 0 && !limits.strikes.take(1.0, config::rate_limit_strikes, now))
+	{
+		PRINT_WARNING("Disconnecting %s for exceeding the %s rate limit", networking::get_ip(peer->address).c_str(), limiter::get_class_name(type));
+		metrics::record_rate_limit_disconnect();
+		enet_peer_disconnect(peer, 0);
+	}
+
+	return false;
+}
+
+message_class_t limiter::classify(const ENetPacket* packet)
+{
+	static const char prefix[] = "proto=";
+	constexpr auto prefix_length = sizeof(prefix) - 1;
+
+	auto data = (const char*)packet->data;
+	auto length = packet->dataLength;
+
+	if (length <= prefix_length || std::memcmp(data, prefix, prefix_length))
+	{
+		return message_class_t::OTHER;
+	}
+
+	auto proto = 0;
+	auto digits = 0u;
+
+	for (auto i = prefix_length; i < length && digits < 3 && data[i] >= '0' && data[i] <= '9'; ++i, ++digits)
+	{
+		proto = proto * 10 + (data[i] - '0');
+	}
+
+	if (!digits)
+	{
+		return message_class_t::OTHER;
+	}
+
+	switch ((proto_t)proto)
+	{
+		case proto_t::CREATE_ROOM:
+		case proto_t::NEW_USER:
+		case proto_t::READY_UP:
+		case proto_t::START_GAME:
+		case proto_t::GET_USER_LIST:
+		case proto_t::NAME_CHANGE:
+		case proto_t::GET_LEVEL_LIST:
+		case proto_t::MATCHMAKE:
+		case proto_t::GET_ROOM_LIST:
+			return message_class_t::LOBBY;
+
+		case proto_t::USE_POWEWRUP:
+		case proto_t::DIED:
+		case proto_t::SCORE_UPDATE:
+		case proto_t::START_ACK:
+			return message_class_t::GAMEPLAY;
+	}
+
+	return message_class_t::OTHER;
+}
+
+const char* limiter::get_class_name(message_class_t type)
+{
+	switch (type)
+	{
+		case message_class_t::LOBBY: return "lobby";
+		case message_class_t::GAMEPLAY: return "gameplay";
+		case message_class_t::OTHER: return "other";
+	}
+
+	return "unknown";
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+enum class message_class_t : std::uint8_t
+{
+	LOBBY,
+	GAMEPLAY,
+	OTHER,
+	COUNT,
+};
+
+struct token_bucket_t
+{
+	double tokens = 0.0;
+	std::chrono::steady_clock::time_point last;
+
+	// A fresh bucket starts full, the first refill covers an arbitrarily long gap
+	bool take(double rate, double burst, std::chrono::steady_clock::time_point now, double cost = 1.0);
+};
+
+struct peer_limits_t
+{
+	token_bucket_t packets;
+	std::array<token_bucket_t, (std::size_t)message_class_t::COUNT> classes;
+
+	// Every dropped packet spends a strike, running out of strikes gets the peer disconnected
+	token_bucket_t strikes;
+};
+
+// Runs on the raw packet before anything is split or allocated, so flooding costs the server
+// a couple of comparisons per packet instead of a full parse
+class limiter final
+{
+public:
+	static bool admit(ENetPeer* peer, peer_limits_t& limits, const ENetPacket* packet);
+	static message_class_t classify(const ENetPacket* packet);
+	static const char* get_class_name(message_class_t type);
+};
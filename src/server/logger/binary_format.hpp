@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary log layout, shared with the log-decoder tool.
+// A file is a header followed by records. A FORMAT record is written the first time a call site logs
+// and maps its id to the level, function and printf format, MESSAGE records then only carry the id and raw arguments
+namespace binary_log
+{
+	constexpr std::uint32_t magic_value = 0x4C474550; // "PEGL"
+	constexpr std::uint32_t format_version = 1;
+
+	enum record_t : std::uint8_t
+	{
+		FORMAT,
+		MESSAGE,
+	};
+
+	// Every argument is a tag byte followed by 8 bytes, or a u32 length and the bytes for strings
+	enum arg_t : std::uint8_t
+	{
+		ARG_SIGNED = 'i',
+		ARG_UNSIGNED = 'u',
+		ARG_FLOAT = 'f',
+		ARG_STRING = 's',
+		ARG_POINTER = 'p',
+	};
+}
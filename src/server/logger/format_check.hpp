@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Compile time validation of printf style formats against the argument types that are actually passed
+namespace format_check
+{
+	enum kind_t : std::uint8_t
+	{
+		KIND_NONE,
+		KIND_INTEGER,
+		KIND_FLOAT,
+		KIND_STRING,
+		KIND_STRING_OBJECT,
+		KIND_POINTER,
+	};
+
+	struct arg_t
+	{
+		kind_t kind;
+		std::size_t size;
+	};
+
+	template <typename... Args>
+	struct type_list
+	{
+	};
+
+	// Only used inside decltype, the arguments are never evaluated
+	template <typename... Args>
+	type_list<std::decay_t<Args>...> types(const Args&...);
+
+	template <typename T>
+	constexpr arg_t describe()
+	{
+		if constexpr (std::is_enum_v<T>)
+		{
+			return { KIND_INTEGER, sizeof(std::underlying_type_t<T>) };
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			return { KIND_INTEGER, sizeof(T) };
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			return { KIND_FLOAT, sizeof(T) };
+		}
+		else if constexpr (std::is_same_v<T, std::string>)
+		{
+			return { KIND_STRING_OBJECT, sizeof(T) };
+		}
+		else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+		{
+			return { KIND_STRING, sizeof(T) };
+		}
+		else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+		{
+			return { KIND_POINTER, sizeof(T) };
+		}
+		else
+		{
+			return { KIND_NONE, 0 };
+		}
+	}
+
+	constexpr bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// A size of zero means no length modifier, anything up to int is promoted to int
+	constexpr bool integer_fits(const arg_t& arg, std::size_t size)
+	{
+		return arg.kind == KIND_INTEGER && (size ? arg.size == size : arg.size <= sizeof(int));
+	}
+
+	template <typename... Args>
+	constexpr bool check(type_list<Args...>, const char* format)
+	{
+		constexpr arg_t args[] = { describe<Args>()..., { KIND_NONE, 0 } };
+		constexpr std::size_t count = sizeof...(Args);
+
+		std::size_t next = 0;
+
+		for (std::size_t i = 0; format[i]; ++i)
+		{
+			if (format[i] != '%')
+			{
+				continue;
+			}
+
+			if (format[++i] == '%')
+			{
+				continue;
+			}
+
+			while (format[i] == '-' || format[i] == '+' || format[i] == ' ' || format[i] == '#' || format[i] == '0')
+			{
+				++i;
+			}
+
+			// Width and precision, either inline or taken from an int argument
+			for (auto pass = 0; pass < 2; ++pass)
+			{
+				if (pass == 1)
+				{
+					if (format[i] != '.')
+					{
+						break;
+					}
+
+					++i;
+				}
+
+				if (format[i] == '*')
+				{
+					if (next >= count || !integer_fits(args[next++], 0))
+					{
+						return false;
+					}
+
+					++i;
+				}
+
+				while (is_digit(format[i]))
+				{
+					++i;
+				}
+			}
+
+			std::size_t size = 0;
+			bool wide = false;
+
+			switch (format[i])
+			{
+				case 'h':
+					i += format[i + 1] == 'h' ? 2 : 1;
+					break;
+
+				case 'l':
+					if (format[i + 1] == 'l')
+					{
+						size = sizeof(long long);
+						i += 2;
+					}
+					else
+					{
+						size = sizeof(long);
+						wide = true;
+						++i;
+					}
+					break;
+
+				case 'j':
+					size = sizeof(std::intmax_t);
+					++i;
+					break;
+
+				case 'z':
+					size = sizeof(std::size_t);
+					++i;
+					break;
+
+				case 't':
+					size = sizeof(std::ptrdiff_t);
+					++i;
+					break;
+
+				case 'I':
+					if (format[i + 1] == '6' && format[i + 2] == '4')
+					{
+						size = 8;
+						i += 3;
+					}
+					else if (format[i + 1] == '3' && format[i + 2] == '2')
+					{
+						size = 4;
+						i += 3;
+					}
+					else
+					{
+						size = sizeof(std::size_t);
+						++i;
+					}
+					break;
+
+				case 'L':
+					// Arguments are passed through as double, long double would be read wrongly
+					return false;
+			}
+
+			if (next >= count)
+			{
+				return false;
+			}
+
+			auto& arg = args[next++];
+
+			switch (format[i])
+			{
+				case 'd':
+				case 'i':
+				case 'u':
+				case 'o':
+				case 'x':
+				case 'X':
+				case 'c':
+					if (!integer_fits(arg, size))
+					{
+						return false;
+					}
+					break;
+
+				case 'f':
+				case 'F':
+				case 'e':
+				case 'E':
+				case 'g':
+				case 'G':
+				case 'a':
+				case 'A':
+					if (arg.kind != KIND_FLOAT || size)
+					{
+						return false;
+					}
+					break;
+
+				case 's':
+					if ((arg.kind != KIND_STRING && arg.kind != KIND_STRING_OBJECT) || wide)
+					{
+						return false;
+					}
+					break;
+
+				case 'p':
+					if ((arg.kind != KIND_POINTER && arg.kind != KIND_STRING) || size)
+					{
+						return false;
+					}
+					break;
+
+				// %n and anything unknown
+				default:
+					return false;
+			}
+		}
+
+		return next == count;
+	}
+
+	template <bool valid>
+	constexpr bool assert_valid()
+	{
+		static_assert(valid, "Format string does not match its arguments");
+		return valid;
+	}
+}
+
+#define CHECK_FORMAT(__FMT__, ...)																\
+	static_assert(format_check::check(decltype(format_check::types(__VA_ARGS__)){}, __FMT__),	\
+		"Format string does not match its arguments: " __FMT__)
+
+// Checked equivalents of logger::va and logger::append for use in expressions
+#define FORMAT_VA(__FMT__, ...)																	\
+	(format_check::assert_valid<format_check::check(decltype(format_check::types(__VA_ARGS__)){}, __FMT__)>(), logger::va(__FMT__, __VA_ARGS__))
+
+#define FORMAT_APPEND(__OUT__, __FMT__, ...)													\
+	(format_check::assert_valid<format_check::check(decltype(format_check::types(__VA_ARGS__)){}, __FMT__)>(), logger::append(__OUT__, __FMT__, __VA_ARGS__))
@@ -1,3 +1,142 @@
 #include "logger.hpp"
 
-_iobuf* logger::file;
\ No newline at end of file
+_iobuf* logger::file;
+std::FILE* logger::binary_file;
+bool logger::console = true;
+log_level_t logger::level = log_level_t::LVL_DEBUG;
+log_limit_t logger::limits[4] = { { 100, 100 }, { 50, 100 }, { 20, 100 }, { 20, 100 } };
+
+namespace
+{
+	std::mutex binary_mutex;
+	std::uint32_t next_id = 1;
+
+	log_site_t suppressed_sites[] =
+	{
+		{ log_level_t::LVL_DEBUG, "logger", "Suppressed %u lines from %s: \"%s\"", "[ DEBUG ]: Suppressed %u lines from %s: \"%s\"\n", 0 },
+		{ log_level_t::LVL_INFO, "logger", "Suppressed %u lines from %s: \"%s\"", "[ INFO ]: Suppressed %u lines from %s: \"%s\"\n", 0 },
+		{ log_level_t::LVL_WARNING, "logger", "Suppressed %u lines from %s: \"%s\"", "[ WARNING ]: Suppressed %u lines from %s: \"%s\"\n", 0 },
+		{ log_level_t::LVL_ERROR, "logger", "Suppressed %u lines from %s: \"%s\"", "[ ERROR ]: Suppressed %u lines from %s: \"%s\"\n", 0 },
+	};
+}
+
+bool logger::admit(log_site_t& site, std::uint32_t& suppressed)
+{
+	auto& limit = logger::limits[(int)site.level];
+	suppressed = 0;
+
+	if (!limit.burst)
+	{
+		return true;
+	}
+
+	auto now = (std::uint32_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	auto window = site.window.load(std::memory_order_relaxed);
+
+	if (window != now && site.window.compare_exchange_strong(window, now, std::memory_order_relaxed))
+	{
+		site.count.store(0, std::memory_order_relaxed);
+	}
+
+	auto count = site.count.fetch_add(1, std::memory_order_relaxed);
+
+	// Sampled lines are capped at another burst, so a site never writes more than twice its burst a second
+	if (count >= limit.burst)
+	{
+		auto over = count - limit.burst;
+
+		if (!limit.sample || over % limit.sample || over / limit.sample >= limit.burst)
+		{
+			site.suppressed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+
+	suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+	return true;
+}
+
+void logger::report_suppressed(log_site_t& site, std::uint32_t suppressed)
+{
+	logger::emit(suppressed_sites[(int)site.level], suppressed, site.function, site.format);
+}
+
+bool logger::open_binary(const std::string& path)
+{
+	logger::binary_file = std::fopen(path.c_str(), "wb");
+
+	if (!logger::binary_file)
+	{
+		return false;
+	}
+
+	std::setvbuf(logger::binary_file, nullptr, _IOFBF, 1 << 16);
+
+	std::uint32_t header[] = { binary_log::magic_value, binary_log::format_version };
+	std::fwrite(header, sizeof(header), 1, logger::binary_file);
+	return true;
+}
+
+void logger::flush()
+{
+	if (logger::binary_file)
+	{
+		std::fflush(logger::binary_file);
+	}
+}
+
+std::vector<std::uint8_t>& logger::begin_record(log_site_t& site, std::size_t arg_count)
+{
+	thread_local std::vector<std::uint8_t> buffer;
+	buffer.clear();
+
+	auto id = site.id.load(std::memory_order_acquire);
+
+	if (!id)
+	{
+		std::lock_guard<std::mutex> lock(binary_mutex);
+		id = site.id.load(std::memory_order_relaxed);
+
+		if (!id)
+		{
+			id = next_id++;
+
+			auto function_length = (std::uint16_t)std::strlen(site.function);
+			auto format_length = (std::uint16_t)std::strlen(site.format);
+
+			buffer.push_back(binary_log::FORMAT);
+			buffer.insert(buffer.end(), (const std::uint8_t*)&id, (const std::uint8_t*)&id + sizeof(id));
+			buffer.push_back((std::uint8_t)site.level);
+			buffer.insert(buffer.end(), (const std::uint8_t*)&function_length, (const std::uint8_t*)&function_length + sizeof(function_length));
+			buffer.insert(buffer.end(), site.function, site.function + function_length);
+			buffer.insert(buffer.end(), (const std::uint8_t*)&format_length, (const std::uint8_t*)&format_length + sizeof(format_length));
+			buffer.insert(buffer.end(), site.format, site.format + format_length);
+
+			// The definition has to reach the file before any message that uses the id
+			std::fwrite(buffer.data(), buffer.size(), 1, logger::binary_file);
+			buffer.clear();
+
+			site.id.store(id, std::memory_order_release);
+		}
+	}
+
+	auto time = (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	buffer.push_back(binary_log::MESSAGE);
+	buffer.insert(buffer.end(), (const std::uint8_t*)&id, (const std::uint8_t*)&id + sizeof(id));
+	buffer.insert(buffer.end(), (const std::uint8_t*)&time, (const std::uint8_t*)&time + sizeof(time));
+	buffer.push_back((std::uint8_t)arg_count);
+
+	return buffer;
+}
+
+void logger::end_record(log_site_t& site, std::vector<std::uint8_t>& buffer)
+{
+	std::fwrite(buffer.data(), buffer.size(), 1, logger::binary_file);
+
+	// Keep problems on disk straight away, routine lines go out with the periodic flush
+	if (site.level >= log_level_t::LVL_WARNING)
+	{
+		std::fflush(logger::binary_file);
+	}
+}
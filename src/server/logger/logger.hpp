@@ -4,45 +4,129 @@
 #include <cstdio>
 #include <algorithm>
 #include <regex>
+#include <type_traits>
+#include <atomic>
+#include <cstring>
+#include <vector>
 
-#define PRINT_FILE_CONSOLE(__FMT__, ...)												\
-	if (logger::file)									\
+#include "binary_format.hpp"
+#include "format_check.hpp"
+
+enum class log_level_t : std::uint8_t
+{
+	LVL_DEBUG,
+	LVL_INFO,
+	LVL_WARNING,
+	LVL_ERROR,
+};
+
+// One per call site, the id is handed out the first time the site is written to a binary log
+struct log_site_t
+{
+	log_level_t level;
+	const char* function;
+	const char* format;
+	const char* text_format;
+	std::atomic<std::uint32_t> id;
+
+	// Rate limiting state, reset every second
+	std::atomic<std::uint32_t> window;
+	std::atomic<std::uint32_t> count;
+	std::atomic<std::uint32_t> suppressed;
+};
+
+// Per level: the first burst lines a second from a site are written, then one in sample, a burst of 0 disables the limit
+struct log_limit_t
+{
+	std::uint32_t burst;
+	std::uint32_t sample;
+};
+
+// Arguments are only evaluated when the level is enabled
+#define PRINT_LOG(__LEVEL__, __PREFIX__, __FMT__, ...)									\
+	do																					\
 	{																					\
-		std::fprintf(logger::file, __FMT__, __VA_ARGS__);										\
-		std::fflush(logger::file);																\
-	}																					\
-																						\
-	std::printf(__FMT__, __VA_ARGS__)
+		CHECK_FORMAT(__FMT__, __VA_ARGS__);												\
+		if (__LEVEL__ >= logger::level)													\
+		{																				\
+			static log_site_t __site = { __LEVEL__, __FUNCTION__, __FMT__, __PREFIX__ __FMT__ "\n", 0 };	\
+			logger::print(__site, __VA_ARGS__);											\
+		}																				\
+	} while (0)
 
 #ifdef DEBUG
 #define PRINT_DEBUG(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ DEBUG ][" __FUNCTION__ "]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_DEBUG, "[ DEBUG ][" __FUNCTION__ "]: ", __FMT__, __VA_ARGS__)
 
 #define PRINT_INFO(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ INFO ][" __FUNCTION__ "]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_INFO, "[ INFO ][" __FUNCTION__ "]: ", __FMT__, __VA_ARGS__)
 
 #define PRINT_WARNING(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ WARNING ][" __FUNCTION__ "]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_WARNING, "[ WARNING ][" __FUNCTION__ "]: ", __FMT__, __VA_ARGS__)
 
 #define PRINT_ERROR(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ ERROR ][" __FUNCTION__ "]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_ERROR, "[ ERROR ][" __FUNCTION__ "]: ", __FMT__, __VA_ARGS__)
 #else
 #define PRINT_DEBUG(__FMT__, ...)
 
 #define PRINT_INFO(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ INFO ]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_INFO, "[ INFO ]: ", __FMT__, __VA_ARGS__)
 
 #define PRINT_WARNING(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ WARNING ]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_WARNING, "[ WARNING ]: ", __FMT__, __VA_ARGS__)
 
 #define PRINT_ERROR(__FMT__, ...)													\
-		PRINT_FILE_CONSOLE("[ ERROR ]: " __FMT__ "\n", __VA_ARGS__)
+		PRINT_LOG(log_level_t::LVL_ERROR, "[ ERROR ]: ", __FMT__, __VA_ARGS__)
 #endif
 
 class logger
 {
 public:
 	static _iobuf* file;
+	static std::FILE* binary_file;
+	static bool console;
+	static log_level_t level;
+	static log_limit_t limits[4];
+
+	template <typename... Args>
+	static void print(log_site_t& site, const Args&... args)
+	{
+		std::uint32_t suppressed;
+
+		if (!logger::admit(site, suppressed))
+		{
+			return;
+		}
+
+		if (suppressed)
+		{
+			logger::report_suppressed(site, suppressed);
+		}
+
+		logger::emit(site, args...);
+	}
+
+	template <typename... Args>
+	static void emit(log_site_t& site, const Args&... args)
+	{
+		if (logger::binary_file)
+		{
+			logger::write_binary(site, args...);
+		}
+		else if (logger::file)
+		{
+			std::fprintf(logger::file, site.text_format, logger::printf_arg(args)...);
+			std::fflush(logger::file);
+		}
+
+		if (logger::console)
+		{
+			std::printf(site.text_format, logger::printf_arg(args)...);
+		}
+	}
+
+	static bool open_binary(const std::string& path);
+	static void flush();
 
 	static void init(const char* title)
 	{
@@ -50,7 +134,7 @@ public:
 		{
 			std::ios_base::sync_with_stdio(false);
 
-			file = std::fopen(logger::va("server.log", title).c_str(), "wb");
+			file = std::fopen("server.log", "wb");
 
 			AllocConsole();
 			SetConsoleTitleA(title);
@@ -60,13 +144,29 @@ public:
 		}
 	}
 
-	static std::string va(const char* fmt, ...)
+	// Unchecked, call through FORMAT_VA and FORMAT_APPEND so the format is validated at compile time
+	template <typename... Args>
+	static std::string va(const char* fmt, const Args&... args)
 	{
-		va_list va;
-		va_start(va, fmt);
-		char result[512]{};
-		std::vsprintf(result, fmt, va);
-		return std::string(result);
+		std::string result;
+		logger::append(result, fmt, args...);
+		return result;
+	}
+
+	// Formats straight onto the end of an existing buffer, sized up front so nothing is ever truncated
+	template <typename... Args>
+	static void append(std::string& output, const char* fmt, const Args&... args)
+	{
+		auto length = std::snprintf(nullptr, 0, fmt, logger::printf_arg(args)...);
+
+		if (length <= 0)
+		{
+			return;
+		}
+
+		auto offset = output.size();
+		output.resize(offset + length);
+		std::snprintf(&output[offset], length + 1, fmt, logger::printf_arg(args)...);
 	}
 
 	static std::vector<std::string> split(const std::string& s, const std::string& seperator)
@@ -107,4 +207,87 @@ public:
 	{
 		return std::regex_replace(in, std::regex(from), to);
 	}
+
+private:
+	static bool admit(log_site_t& site, std::uint32_t& suppressed);
+	static void report_suppressed(log_site_t& site, std::uint32_t suppressed);
+
+	template <typename T>
+	static decltype(auto) printf_arg(const T& value)
+	{
+		if constexpr (std::is_same_v<T, std::string>)
+		{
+			return value.c_str();
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			return (std::underlying_type_t<T>)value;
+		}
+		else
+		{
+			return (value);
+		}
+	}
+
+	static std::vector<std::uint8_t>& begin_record(log_site_t& site, std::size_t arg_count);
+	static void end_record(log_site_t& site, std::vector<std::uint8_t>& buffer);
+
+	template <typename... Args>
+	static void write_binary(log_site_t& site, const Args&... args)
+	{
+		auto& buffer = logger::begin_record(site, sizeof...(args));
+		(logger::encode(buffer, args), ...);
+		logger::end_record(site, buffer);
+	}
+
+	static void encode_raw(std::vector<std::uint8_t>& buffer, binary_log::arg_t tag, std::uint64_t value)
+	{
+		buffer.push_back(tag);
+		buffer.insert(buffer.end(), (const std::uint8_t*)&value, (const std::uint8_t*)&value + sizeof(value));
+	}
+
+	static void encode_string(std::vector<std::uint8_t>& buffer, const char* value, std::uint32_t length)
+	{
+		buffer.push_back(binary_log::ARG_STRING);
+		buffer.insert(buffer.end(), (const std::uint8_t*)&length, (const std::uint8_t*)&length + sizeof(length));
+		buffer.insert(buffer.end(), (const std::uint8_t*)value, (const std::uint8_t*)value + length);
+	}
+
+	template <typename T>
+	static void encode(std::vector<std::uint8_t>& buffer, const T& value)
+	{
+		if constexpr (std::is_enum_v<T>)
+		{
+			logger::encode(buffer, (std::underlying_type_t<T>)value);
+		}
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+		{
+			logger::encode_raw(buffer, binary_log::ARG_SIGNED, (std::uint64_t)(std::int64_t)value);
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			logger::encode_raw(buffer, binary_log::ARG_UNSIGNED, (std::uint64_t)value);
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			double as_double = value;
+			std::uint64_t bits;
+			std::memcpy(&bits, &as_double, sizeof(bits));
+			logger::encode_raw(buffer, binary_log::ARG_FLOAT, bits);
+		}
+		else if constexpr (std::is_same_v<T, std::string>)
+		{
+			logger::encode_string(buffer, value.data(), (std::uint32_t)value.size());
+		}
+		else if constexpr (std::is_convertible_v<const T&, const char*>)
+		{
+			const char* string = value;
+			logger::encode_string(buffer, string ? string : "(null)", (std::uint32_t)std::strlen(string ? string : "(null)"));
+		}
+		else
+		{
+			static_assert(std::is_pointer_v<T>, "Unsupported log argument type");
+			logger::encode_raw(buffer, binary_log::ARG_POINTER, (std::uint64_t)(std::uintptr_t)value);
+		}
+	}
 };
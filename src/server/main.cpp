@@ -1,32 +1,94 @@
 #include "logger/logger.hpp"
 #include "global/global.hpp"
+#include "config/config.hpp"
 #include "networking/networking.hpp"
+#include "metrics/metrics.hpp"
+#include "http/http.hpp"
+#include "stats/stats.hpp"
+#include "trace/trace.hpp"
+#include "recorder/recorder.hpp"
+#include "capture/capture.hpp"
+#include "timesync/timesync.hpp"
+#include "matchmaker/matchmaker.hpp"
 
-void init()
+void init(int argc, char* argv[])
 {
 	logger::init("server");
 
 	std::printf("---------- PegRoyale Dedicated Server ----------\n\n");
 
-	if (enet_initialize() != 0)
+	if (enet_initialize_with_callbacks(ENET_VERSION, &stats::callbacks) != 0)
 	{
 		PRINT_ERROR("Failed to start Enet");
 		PRINT_ERROR("Shutting down (%i)", -1);
 		return;
 	}
 
-	networking::init();
+	config::init(argc, argv);
+
+	if (!config::binary_log.empty())
+	{
+		if (logger::open_binary(config::binary_log))
+		{
+			PRINT_INFO("Writing binary log to \"%s\"", config::binary_log.c_str());
+		}
+		else
+		{
+			PRINT_ERROR("Unable to open binary log \"%s\"", config::binary_log.c_str());
+		}
+	}
+
+	logger::console = config::log_console != 0;
+	logger::level = (log_level_t)config::log_level;
+	logger::limits[0] = { (std::uint32_t)std::max(0, config::log_burst_debug), (std::uint32_t)std::max(0, config::log_sample_debug) };
+	logger::limits[1] = { (std::uint32_t)std::max(0, config::log_burst_info), (std::uint32_t)std::max(0, config::log_sample_info) };
+	logger::limits[2] = { (std::uint32_t)std::max(0, config::log_burst_warning), (std::uint32_t)std::max(0, config::log_sample_warning) };
+	logger::limits[3] = { (std::uint32_t)std::max(0, config::log_burst_error), (std::uint32_t)std::max(0, config::log_sample_error) };
+
+	metrics::init();
+	timesync::init();
+	matchmaker::init();
+	trace::init();
+	recorder::init();
+	capture::init();
+
+	if (!config::replay.empty())
+	{
+		capture::replay();
+	}
+	else
+	{
+		networking::init();
+		http::init();
+		stats::init();
+	}
 
 	while (!global::shutdown)
 	{
 		networking::update();
+		metrics::update();
+		http::publish();
+		stats::publish();
+		capture::update();
+		logger::flush();
+	}
+
+	trace::flush();
+	capture::cleanup();
+	stats::cleanup();
+	http::cleanup();
+
+	if (config::metrics_interval > 0 || !config::replay.empty())
+	{
+		metrics::dump();
 	}
 
 	networking::cleanup();
+	logger::flush();
 }
 
 int __cdecl main(int argc, char* argv[])
 {
-	init();
+	init(argc, argv);
 	return 0;
 }
@@ -0,0 +1,297 @@
+#include "matchmaker.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "networking/networking.hpp"
+
+std::vector<std::vector<int>> matchmaker::buckets;
+std::vector<queued_player_t> matchmaker::queue;
+std::uint32_t matchmaker::next_ticket = 0;
+std::uint32_t matchmaker::next_id = 0;
+std::chrono::steady_clock::time_point matchmaker::last_update;
+
+void matchmaker::init()
+{
+	matchmaker::buckets.assign((config::rtt_bands + 1) * (config::room_capacity + 1), {});
+}
+
+void matchmaker::update()
+{
+	auto now = networking::event_time;
+
+	if (now - matchmaker::last_update < std::chrono::milliseconds(100))
+	{
+		return;
+	}
+
+	matchmaker::last_update = now;
+
+	auto kept = 0u;
+
+	for (auto i = 0u; i < matchmaker::queue.size(); ++i)
+	{
+		auto& entry = matchmaker::queue[i];
+		auto state = (peer_state_t*)entry.peer->data;
+
+		// Disconnected, or the slot now belongs to someone else
+		if (!state || state->matchmaking_ticket != entry.ticket)
+		{
+			continue;
+		}
+
+		auto waited = now - entry.since;
+		auto reach = (int)(waited / std::chrono::milliseconds(config::matchmake_widen));
+		auto room = matchmaker::find_room(entry.band, reach);
+
+		if (room == -1 && waited >= std::chrono::milliseconds(config::matchmake_wait))
+		{
+			room = matchmaker::create_room();
+
+			if (room == -1)
+			{
+				state->matchmaking_ticket = 0;
+				networking::send_packet(proto_t::ROOMS_FULL, entry.peer);
+				continue;
+			}
+		}
+
+		if (room != -1)
+		{
+			state->matchmaking_ticket = 0;
+			matchmaker::seat(entry.peer, entry.name, room, waited);
+			continue;
+		}
+
+		if (kept != i)
+		{
+			matchmaker::queue[kept] = std::move(entry);
+		}
+
+		++kept;
+	}
+
+	matchmaker::queue.resize(kept);
+}
+
+void matchmaker::handle(ENetPeer* peer, const std::vector<std::string>& split_packet)
+{
+	std::string name;
+
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		if (split_packet[i].rfind("name=", 0) == 0)
+		{
+			name = split_packet[i].substr(5);
+		}
+	}
+
+	if (name.empty())
+	{
+		PRINT_ERROR("Recieved malformed matchmaking request!");
+		return;
+	}
+
+	auto state = networking::get_state(peer);
+
+	if (state->matchmaking_ticket || networking::get_room(peer) != -1)
+	{
+		PRINT_WARNING("Matchmaking request from \"%s\" who is already queued or in a room", name.c_str());
+		return;
+	}
+
+	auto band = matchmaker::get_band(peer);
+	auto room = matchmaker::find_room(band, 0);
+
+	if (room != -1)
+	{
+		matchmaker::seat(peer, name, room, {});
+		return;
+	}
+
+	// Zero marks a peer that is not queued
+	if (!++matchmaker::next_ticket)
+	{
+		++matchmaker::next_ticket;
+	}
+
+	state->matchmaking_ticket = matchmaker::next_ticket;
+	matchmaker::queue.emplace_back(queued_player_t{ peer, name, band, matchmaker::next_ticket, networking::event_time });
+
+	PRINT_DEBUG("Queued \"%s\" in RTT band %i", name.c_str(), band);
+}
+
+void matchmaker::update_room(int room)
+{
+	auto& entry = networking::rooms[room];
+
+	if (entry.players.empty())
+	{
+		entry.seats.band = -1;
+	}
+	else if (entry.seats.band == -1)
+	{
+		entry.seats.band = matchmaker::get_band(entry.players.front().peer);
+	}
+
+	auto bucket = -1;
+
+	if (entry.key == "_" && !entry.playing && entry.players.size() < (std::size_t)config::room_capacity)
+	{
+		auto row = entry.seats.band == -1 ? config::rtt_bands : entry.seats.band;
+		bucket = row * (config::room_capacity + 1) + config::room_capacity - (int)entry.players.size();
+	}
+
+	if (bucket == entry.seats.bucket)
+	{
+		return;
+	}
+
+	matchmaker::unlink(room);
+
+	if (bucket != -1)
+	{
+		auto& list = matchmaker::buckets[bucket];
+		entry.seats.bucket = bucket;
+		entry.seats.position = (int)list.size();
+		list.emplace_back(room);
+	}
+}
+
+void matchmaker::erase_room(int room)
+{
+	matchmaker::unlink(room);
+
+	// Erasing from the room list is linear already, renumbering the index costs no more than that
+	for (auto& list : matchmaker::buckets)
+	{
+		for (auto& index : list)
+		{
+			if (index > room)
+			{
+				--index;
+			}
+		}
+	}
+}
+
+int matchmaker::find_room(int band, int reach)
+{
+	// Own band first, then rooms nobody has joined yet, then neighbouring bands nearest first
+	auto room = matchmaker::find_in_row(band);
+
+	if (room == -1)
+	{
+		room = matchmaker::find_in_row(config::rtt_bands);
+	}
+
+	for (auto distance = 1; room == -1 && distance <= reach && distance < config::rtt_bands; ++distance)
+	{
+		if (band - distance >= 0)
+		{
+			room = matchmaker::find_in_row(band - distance);
+		}
+
+		if (room == -1 && band + distance < config::rtt_bands)
+		{
+			room = matchmaker::find_in_row(band + distance);
+		}
+	}
+
+	return room;
+}
+
+void matchmaker::report_match(int room)
+{
+	enet_uint32 lowest = UINT32_MAX, highest = 0;
+
+	for (auto& player : networking::rooms[room].players)
+	{
+		if (player.peer)
+		{
+			lowest = std::min(lowest, player.peer->roundTripTime);
+			highest = std::max(highest, player.peer->roundTripTime);
+		}
+	}
+
+	if (lowest > highest)
+	{
+		return;
+	}
+
+	metrics::record_room_rtt_spread((std::uint64_t)(highest - lowest) * 1000000);
+	PRINT_DEBUG("Room \"%s\" RTT %u-%u ms", networking::rooms[room].id.c_str(), lowest, highest);
+}
+
+int matchmaker::get_band(ENetPeer* peer)
+{
+	auto rtt = peer ? peer->roundTripTime : 0;
+	return std::min((int)(rtt / config::rtt_band_width), config::rtt_bands - 1);
+}
+
+std::size_t matchmaker::queued()
+{
+	return matchmaker::queue.size();
+}
+
+int matchmaker::find_in_row(int row)
+{
+	// Bounded by the room capacity, not the number of rooms
+	auto first = row * (config::room_capacity + 1);
+
+	for (auto i = 1; i <= config::room_capacity; ++i)
+	{
+		if (!matchmaker::buckets[first + i].empty())
+		{
+			return matchmaker::buckets[first + i].back();
+		}
+	}
+
+	return -1;
+}
+
+int matchmaker::create_room()
+{
+	// A room created by hand may already have taken the next id
+	std::string roomid;
+
+	do
+	{
+		roomid = FORMAT_VA("public-%u", ++matchmaker::next_id);
+	} while (networking::find_room(roomid) != -1);
+
+	if (!networking::create_room(roomid, "_"))
+	{
+		return -1;
+	}
+
+	return (int)networking::rooms.size() - 1;
+}
+
+void matchmaker::seat(ENetPeer* peer, const std::string& name, int room, std::chrono::steady_clock::duration waited)
+{
+	PRINT_DEBUG("Matchmaking \"%s\" into room \"%s\"", name.c_str(), networking::rooms[room].id.c_str());
+	metrics::record_matchmake_wait((std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+
+	networking::send_packet(proto_t::MATCHMAKE, peer, FORMAT_VA("roomid=%s;", networking::rooms[room].id.c_str()));
+	networking::join_room(peer, room, name);
+}
+
+void matchmaker::unlink(int room)
+{
+	auto& seats = networking::rooms[room].seats;
+
+	if (seats.bucket == -1)
+	{
+		return;
+	}
+
+	// Swap with the last entry so removal never shifts the rest of the bucket
+	auto& list = matchmaker::buckets[seats.bucket];
+	auto moved = list.back();
+	list[seats.position] = moved;
+	networking::rooms[moved].seats.position = seats.position;
+	list.pop_back();
+
+	seats.bucket = -1;
+	seats.position = -1;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Where a public room is filed in the free seat index. The band is taken from the first player's RTT,
+// bucket -1 means the room takes no matchmade players
+struct room_seats_t
+{
+	int band = -1;
+	int bucket = -1;
+	int position = -1;
+};
+
+struct queued_player_t
+{
+	ENetPeer* peer;
+	std::string name;
+	int band;
+	std::uint32_t ticket;
+	std::chrono::steady_clock::time_point since;
+};
+
+// Public rooms that are waiting for players, bucketed by RTT band and by how many seats they have left.
+// A player is seated in the fullest room of their own band that still has space, so rooms fill one at
+// a time with players on similar links. Players with no room in their band wait in the queue while the
+// search widens to neighbouring bands, and get a room of their own once they have waited long enough
+class matchmaker final
+{
+public:
+	static void init();
+	static void update();
+	static void handle(ENetPeer* peer, const std::vector<std::string>& split_packet);
+
+	// Refiles a room after its roster or state changed, call it whenever either does
+	static void update_room(int room);
+
+	// Call before the room is erased, every index above it shifts down by one
+	static void erase_room(int room);
+
+	// Fullest public room with a free seat at most reach bands away, or -1
+	static int find_room(int band, int reach);
+
+	// Records how far apart the players' RTTs are in a room that is starting a match
+	static void report_match(int room);
+
+	static int get_band(ENetPeer* peer);
+	static std::size_t queued();
+
+private:
+	static int find_in_row(int row);
+	static int create_room();
+	static void seat(ENetPeer* peer, const std::string& name, int room, std::chrono::steady_clock::duration waited);
+	static void unlink(int room);
+
+	// Row per band plus one for rooms nobody has joined yet, a row holds a bucket per free seat count
+	// and bucket 0 is never filled
+	static std::vector<std::vector<int>> buckets;
+
+	// Entries of players who disconnected stay behind until the next update sweeps them out,
+	// the ticket tells a live entry from one whose peer slot has been reused
+	static std::vector<queued_player_t> queue;
+	static std::uint32_t next_ticket;
+	static std::uint32_t next_id;
+	static std::chrono::steady_clock::time_point last_update;
+};
@@ -0,0 +1,391 @@
+#include "metrics.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+
+std::mutex metrics::registry_mutex;
+std::vector<std::unique_ptr<metrics::thread_counters_t>> metrics::registry;
+std::chrono::steady_clock::time_point metrics::last_dump;
+
+int histogram_t::index_of(std::uint64_t value)
+{
+	if (value < sub_buckets)
+	{
+		return (int)value;
+	}
+
+	int msb = 0;
+
+	for (auto shift = 32; shift; shift >>= 1)
+	{
+		if (value >> (msb + shift))
+		{
+			msb += shift;
+		}
+	}
+
+	auto sub = (int)(value >> (msb - sub_bucket_bits)) & (sub_buckets - 1);
+	return (msb - sub_bucket_bits + 1) * sub_buckets + sub;
+}
+
+std::uint64_t histogram_t::lower_bound(int index)
+{
+	if (index < sub_buckets)
+	{
+		return index;
+	}
+
+	auto group = index / sub_buckets;
+	auto sub = index % sub_buckets;
+	return std::uint64_t(sub_buckets + sub) << (group - 1);
+}
+
+std::uint64_t histogram_t::percentile(double p) const
+{
+	if (!count)
+	{
+		return 0;
+	}
+
+	auto target = std::uint64_t(p * count);
+	std::uint64_t seen = 0;
+
+	for (auto i = 0; i < bucket_count; ++i)
+	{
+		seen += buckets[i];
+
+		if (seen > target)
+		{
+			return std::min(histogram_t::lower_bound(i), max);
+		}
+	}
+
+	return max;
+}
+
+std::uint64_t histogram_t::count_below(std::uint64_t value) const
+{
+	std::uint64_t result = 0;
+	auto end = histogram_t::index_of(value);
+
+	for (auto i = 0; i < end; ++i)
+	{
+		result += buckets[i];
+	}
+
+	return result;
+}
+
+void metrics::thread_histogram_t::record(std::uint64_t value)
+{
+	metrics::add(this->total, value);
+	metrics::add(this->buckets[histogram_t::index_of(value)], 1);
+
+	if (value > this->max.load(std::memory_order_relaxed))
+	{
+		this->max.store(value, std::memory_order_relaxed);
+	}
+}
+
+void metrics::thread_histogram_t::merge_into(histogram_t& histogram) const
+{
+	histogram.total += this->total.load(std::memory_order_relaxed);
+	histogram.max = std::max(histogram.max, this->max.load(std::memory_order_relaxed));
+
+	for (auto i = 0; i < histogram_t::bucket_count; ++i)
+	{
+		auto hits = this->buckets[i].load(std::memory_order_relaxed);
+		histogram.buckets[i] += hits;
+		histogram.count += hits;
+	}
+}
+
+metrics::scope::scope(proto_t proto, std::size_t bytes_in) : slot(metrics::slot_of(proto)), start(std::chrono::steady_clock::now())
+{
+	auto& counters = metrics::local().slots[this->slot];
+	metrics::add(counters.count, 1);
+	metrics::add(counters.bytes_in, bytes_in);
+}
+
+metrics::scope::~scope()
+{
+	auto elapsed = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+	metrics::local().slots[this->slot].handler_ns.record(elapsed);
+}
+
+void metrics::init()
+{
+	metrics::last_dump = std::chrono::steady_clock::now();
+}
+
+void metrics::update()
+{
+	if (config::metrics_interval <= 0)
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - metrics::last_dump >= std::chrono::seconds(config::metrics_interval))
+	{
+		metrics::last_dump = now;
+		metrics::dump();
+	}
+}
+
+void metrics::record_send(proto_t proto, std::size_t bytes, std::size_t recipients)
+{
+	auto& counters = metrics::local().slots[metrics::slot_of(proto)];
+	metrics::add(counters.bytes_out, bytes * recipients);
+	metrics::add(counters.packets_out, recipients);
+}
+
+void metrics::record_broadcast(proto_t proto, std::size_t recipients)
+{
+	metrics::add(metrics::local().slots[metrics::slot_of(proto)].fanout, recipients);
+}
+
+void metrics::record_parse_failure(std::size_t bytes)
+{
+	auto& counters = metrics::local();
+	metrics::add(counters.parse_failures, 1);
+	metrics::add(counters.parse_failure_bytes, bytes);
+}
+
+void metrics::record_rate_limited(message_class_t type, std::size_t bytes)
+{
+	auto& counters = metrics::local();
+	metrics::add(counters.rate_limited[(int)type], 1);
+	metrics::add(counters.rate_limited_bytes, bytes);
+}
+
+void metrics::record_rate_limit_disconnect()
+{
+	metrics::add(metrics::local().rate_limit_disconnects, 1);
+}
+
+void metrics::record_congestion(congestion_action_t action)
+{
+	metrics::add(metrics::local().congestion[(int)action], 1);
+}
+
+void metrics::record_room_over_budget(std::size_t bytes)
+{
+	auto& counters = metrics::local();
+	metrics::add(counters.room_over_budget, 1);
+	metrics::add(counters.room_over_budget_bytes, bytes);
+}
+
+void metrics::record_compression(bool compress, std::size_t raw, std::size_t packed, std::uint64_t ns)
+{
+	auto& counters = metrics::local().compression[compress ? 0 : 1];
+	metrics::add(counters.packets, 1);
+	metrics::add(counters.raw_bytes, raw);
+	metrics::add(counters.packed_bytes, packed);
+	counters.ns.record(ns);
+}
+
+void metrics::record_start_skew(std::uint64_t ns)
+{
+	metrics::local().start_skew_ns.record(ns);
+}
+
+void metrics::record_matchmake_wait(std::uint64_t ns)
+{
+	metrics::local().matchmake_wait_ns.record(ns);
+}
+
+void metrics::record_room_rtt_spread(std::uint64_t ns)
+{
+	metrics::local().room_rtt_spread_ns.record(ns);
+}
+
+void metrics::record_tick(std::uint64_t ns)
+{
+	metrics::local().tick_ns.record(ns);
+}
+
+metrics_snapshot_t metrics::snapshot()
+{
+	metrics_snapshot_t result;
+	result.protos.resize(proto_slots);
+
+	std::lock_guard<std::mutex> lock(metrics::registry_mutex);
+
+	for (auto& counters : metrics::registry)
+	{
+		for (auto i = 0; i < proto_slots; ++i)
+		{
+			auto& from = counters->slots[i];
+			auto& to = result.protos[i];
+
+			to.count += from.count.load(std::memory_order_relaxed);
+			to.bytes_in += from.bytes_in.load(std::memory_order_relaxed);
+			to.bytes_out += from.bytes_out.load(std::memory_order_relaxed);
+			to.packets_out += from.packets_out.load(std::memory_order_relaxed);
+			to.fanout += from.fanout.load(std::memory_order_relaxed);
+			from.handler_ns.merge_into(to.handler_ns);
+		}
+
+		result.parse_failures += counters->parse_failures.load(std::memory_order_relaxed);
+		result.parse_failure_bytes += counters->parse_failure_bytes.load(std::memory_order_relaxed);
+		result.rate_limited_bytes += counters->rate_limited_bytes.load(std::memory_order_relaxed);
+		result.rate_limit_disconnects += counters->rate_limit_disconnects.load(std::memory_order_relaxed);
+		result.room_over_budget += counters->room_over_budget.load(std::memory_order_relaxed);
+		result.room_over_budget_bytes += counters->room_over_budget_bytes.load(std::memory_order_relaxed);
+
+		compression_stats_t* compression[] = { &result.compressed, &result.decompressed };
+
+		for (auto i = 0; i < 2; ++i)
+		{
+			auto& from = counters->compression[i];
+			compression[i]->packets += from.packets.load(std::memory_order_relaxed);
+			compression[i]->raw_bytes += from.raw_bytes.load(std::memory_order_relaxed);
+			compression[i]->packed_bytes += from.packed_bytes.load(std::memory_order_relaxed);
+			from.ns.merge_into(compression[i]->ns);
+		}
+
+		for (auto i = 0u; i < result.rate_limited.size(); ++i)
+		{
+			result.rate_limited[i] += counters->rate_limited[i].load(std::memory_order_relaxed);
+		}
+
+		for (auto i = 0u; i < result.congestion.size(); ++i)
+		{
+			result.congestion[i] += counters->congestion[i].load(std::memory_order_relaxed);
+		}
+
+		counters->start_skew_ns.merge_into(result.start_skew_ns);
+		counters->matchmake_wait_ns.merge_into(result.matchmake_wait_ns);
+		counters->room_rtt_spread_ns.merge_into(result.room_rtt_spread_ns);
+		counters->tick_ns.merge_into(result.tick_ns);
+	}
+
+	return result;
+}
+
+void metrics::dump()
+{
+	auto stats = metrics::snapshot();
+
+	PRINT_INFO("%-20s %10s %12s %12s %10s %10s %10s %10s", "proto", "count", "bytes in", "bytes out", "fanout", "p50 us", "p99 us", "max us");
+
+	for (auto i = 0; i < proto_slots; ++i)
+	{
+		auto& proto = stats.protos[i];
+
+		if (!proto.count && !proto.packets_out)
+		{
+			continue;
+		}
+
+		PRINT_INFO(
+			"%-20s %10llu %12llu %12llu %10llu %10.1f %10.1f %10.1f",
+			i ? networking::get_proto_name((proto_t)(i - 1)) : "UNKNOWN",
+			proto.count,
+			proto.bytes_in,
+			proto.bytes_out,
+			proto.fanout,
+			proto.handler_ns.percentile(0.5) / 1000.0,
+			proto.handler_ns.percentile(0.99) / 1000.0,
+			proto.handler_ns.max / 1000.0
+		);
+	}
+
+	PRINT_INFO("Parse failures: %llu (%llu bytes)", stats.parse_failures, stats.parse_failure_bytes);
+	PRINT_INFO(
+		"Rate limited: %llu lobby, %llu gameplay, %llu other (%llu bytes), %llu disconnects",
+		stats.rate_limited[(int)message_class_t::LOBBY],
+		stats.rate_limited[(int)message_class_t::GAMEPLAY],
+		stats.rate_limited[(int)message_class_t::OTHER],
+		stats.rate_limited_bytes,
+		stats.rate_limit_disconnects
+	);
+	PRINT_INFO(
+		"Slow peers: %llu coalesced, %llu downgraded, %llu dropped",
+		stats.congestion[(int)congestion_action_t::COALESCED],
+		stats.congestion[(int)congestion_action_t::DOWNGRADED],
+		stats.congestion[(int)congestion_action_t::DISCONNECTED]
+	);
+	PRINT_INFO("Room broadcasts over budget: %llu (%llu bytes)", stats.room_over_budget, stats.room_over_budget_bytes);
+
+	if (stats.start_skew_ns.count)
+	{
+		PRINT_INFO(
+			"Match start skew: %llu matches, p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+			stats.start_skew_ns.count,
+			stats.start_skew_ns.percentile(0.5) / 1e6,
+			stats.start_skew_ns.percentile(0.99) / 1e6,
+			stats.start_skew_ns.max / 1e6
+		);
+	}
+
+	if (stats.matchmake_wait_ns.count)
+	{
+		PRINT_INFO(
+			"Matchmaking: %llu seated, wait p50 %.1f ms, p99 %.1f ms, %i still queued",
+			stats.matchmake_wait_ns.count,
+			stats.matchmake_wait_ns.percentile(0.5) / 1e6,
+			stats.matchmake_wait_ns.percentile(0.99) / 1e6,
+			(int)matchmaker::queued()
+		);
+	}
+
+	if (stats.room_rtt_spread_ns.count)
+	{
+		PRINT_INFO(
+			"Room RTT spread: %llu matches, p50 %.1f ms, p99 %.1f ms, max %.1f ms",
+			stats.room_rtt_spread_ns.count,
+			stats.room_rtt_spread_ns.percentile(0.5) / 1e6,
+			stats.room_rtt_spread_ns.percentile(0.99) / 1e6,
+			stats.room_rtt_spread_ns.max / 1e6
+		);
+	}
+
+	const std::pair<const char*, const compression_stats_t*> compression[] = { { "Compressed", &stats.compressed }, { "Decompressed", &stats.decompressed } };
+
+	for (auto& entry : compression)
+	{
+		auto& values = *entry.second;
+
+		if (values.packets)
+		{
+			PRINT_INFO(
+				"%s %llu datagrams, %llu -> %llu bytes (%.1f%%), p50 %.1f us, p99 %.1f us",
+				entry.first,
+				values.packets,
+				values.raw_bytes,
+				values.packed_bytes,
+				values.raw_bytes ? values.packed_bytes * 100.0 / values.raw_bytes : 0.0,
+				values.ns.percentile(0.5) / 1000.0,
+				values.ns.percentile(0.99) / 1000.0
+			);
+		}
+	}
+}
+
+std::uint64_t metrics::local_message_count(int slot)
+{
+	return metrics::local().slots[slot].count.load(std::memory_order_relaxed);
+}
+
+int metrics::slot_of(proto_t proto)
+{
+	auto slot = (int)proto + 1;
+	return (slot > 0 && slot < proto_slots) ? slot : 0;
+}
+
+metrics::thread_counters_t& metrics::local()
+{
+	thread_local thread_counters_t* counters = nullptr;
+
+	if (!counters)
+	{
+		// Blocks outlive their thread so totals keep everything a finished thread recorded
+		std::lock_guard<std::mutex> lock(metrics::registry_mutex);
+		metrics::registry.emplace_back(std::make_unique<thread_counters_t>());
+		counters = metrics::registry.back().get();
+	}
+
+	return *counters;
+}
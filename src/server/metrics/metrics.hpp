@@ -0,0 +1,160 @@
+#pragma once
+
+#include "networking/networking.hpp"
+
+// Log-linear latency histogram: each power of two is split into 8 linear sub-buckets,
+// which keeps every recorded value within 12.5% of its bucket's lower edge
+struct histogram_t
+{
+	static constexpr int sub_bucket_bits = 3;
+	static constexpr int sub_buckets = 1 << sub_bucket_bits;
+	static constexpr int bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+	std::array<std::uint64_t, bucket_count> buckets{};
+	std::uint64_t count = 0;
+	std::uint64_t total = 0;
+	std::uint64_t max = 0;
+
+	static int index_of(std::uint64_t value);
+	static std::uint64_t lower_bound(int index);
+
+	std::uint64_t percentile(double p) const;
+	std::uint64_t count_below(std::uint64_t value) const;
+};
+
+struct proto_stats_t
+{
+	std::uint64_t count = 0;
+	std::uint64_t bytes_in = 0;
+	std::uint64_t bytes_out = 0;
+	std::uint64_t packets_out = 0;
+	std::uint64_t fanout = 0;
+	histogram_t handler_ns;
+};
+
+struct compression_stats_t
+{
+	std::uint64_t packets = 0;
+	std::uint64_t raw_bytes = 0;
+	std::uint64_t packed_bytes = 0;
+	histogram_t ns;
+};
+
+struct metrics_snapshot_t
+{
+	std::vector<proto_stats_t> protos;
+	std::uint64_t parse_failures = 0;
+	std::uint64_t parse_failure_bytes = 0;
+	std::array<std::uint64_t, (std::size_t)message_class_t::COUNT> rate_limited{};
+	std::uint64_t rate_limited_bytes = 0;
+	std::uint64_t rate_limit_disconnects = 0;
+	std::array<std::uint64_t, (std::size_t)congestion_action_t::COUNT> congestion{};
+	std::uint64_t room_over_budget = 0;
+	std::uint64_t room_over_budget_bytes = 0;
+	compression_stats_t compressed;
+	compression_stats_t decompressed;
+	histogram_t start_skew_ns;
+	histogram_t matchmake_wait_ns;
+	histogram_t room_rtt_spread_ns;
+	histogram_t tick_ns;
+};
+
+class metrics final
+{
+public:
+	// Slot 0 collects anything that does not map onto a known proto_t
+	static constexpr int proto_slots = 32;
+
+	class scope final
+	{
+	public:
+		scope(proto_t proto, std::size_t bytes_in);
+		~scope();
+
+	private:
+		int slot;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static void init();
+	static void update();
+	static void record_send(proto_t proto, std::size_t bytes, std::size_t recipients = 1);
+	static void record_broadcast(proto_t proto, std::size_t recipients);
+	static void record_parse_failure(std::size_t bytes);
+	static void record_rate_limited(message_class_t type, std::size_t bytes);
+	static void record_rate_limit_disconnect();
+	static void record_congestion(congestion_action_t action);
+	static void record_room_over_budget(std::size_t bytes);
+	static void record_compression(bool compress, std::size_t raw, std::size_t packed, std::uint64_t ns);
+	static void record_start_skew(std::uint64_t ns);
+	static void record_matchmake_wait(std::uint64_t ns);
+	static void record_room_rtt_spread(std::uint64_t ns);
+	static void record_tick(std::uint64_t ns);
+
+	static metrics_snapshot_t snapshot();
+	static std::uint64_t local_message_count(int slot);
+	static void dump();
+
+private:
+	// Written only by the owning thread, read by whoever aggregates.
+	// Relaxed load/store pairs keep the hot path free of locked instructions
+	struct thread_histogram_t
+	{
+		std::atomic<std::uint64_t> total{};
+		std::atomic<std::uint64_t> max{};
+		std::array<std::atomic<std::uint64_t>, histogram_t::bucket_count> buckets{};
+
+		void record(std::uint64_t value);
+		void merge_into(histogram_t& histogram) const;
+	};
+
+	struct thread_counters_t
+	{
+		struct slot_t
+		{
+			std::atomic<std::uint64_t> count{};
+			std::atomic<std::uint64_t> bytes_in{};
+			std::atomic<std::uint64_t> bytes_out{};
+			std::atomic<std::uint64_t> packets_out{};
+			std::atomic<std::uint64_t> fanout{};
+			thread_histogram_t handler_ns;
+		};
+
+		std::array<slot_t, proto_slots> slots;
+		std::atomic<std::uint64_t> parse_failures{};
+		std::atomic<std::uint64_t> parse_failure_bytes{};
+		std::array<std::atomic<std::uint64_t>, (std::size_t)message_class_t::COUNT> rate_limited{};
+		std::atomic<std::uint64_t> rate_limited_bytes{};
+		std::atomic<std::uint64_t> rate_limit_disconnects{};
+		std::array<std::atomic<std::uint64_t>, (std::size_t)congestion_action_t::COUNT> congestion{};
+		std::atomic<std::uint64_t> room_over_budget{};
+		std::atomic<std::uint64_t> room_over_budget_bytes{};
+
+		// Index 0 is compression, 1 decompression
+		struct compression_t
+		{
+			std::atomic<std::uint64_t> packets{};
+			std::atomic<std::uint64_t> raw_bytes{};
+			std::atomic<std::uint64_t> packed_bytes{};
+			thread_histogram_t ns;
+		};
+
+		std::array<compression_t, 2> compression;
+		thread_histogram_t start_skew_ns;
+		thread_histogram_t matchmake_wait_ns;
+		thread_histogram_t room_rtt_spread_ns;
+		thread_histogram_t tick_ns;
+	};
+
+	static int slot_of(proto_t proto);
+	static thread_counters_t& local();
+
+	static void add(std::atomic<std::uint64_t>& counter, std::uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	static std::mutex registry_mutex;
+	static std::vector<std::unique_ptr<thread_counters_t>> registry;
+	static std::chrono::steady_clock::time_point last_dump;
+};
@@ -1,25 +1,77 @@
 #include "networking.hpp"
 #include "logger/logger.hpp"
 #include "global/global.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "trace/trace.hpp"
+#include "recorder/recorder.hpp"
+#include "capture/capture.hpp"
+#include "compression/codec.hpp"
+#include "timesync/timesync.hpp"
+#include "matchmaker/matchmaker.hpp"
+#include "browser/browser.hpp"
+#include "targeting/targeting.hpp"
 
 ENetAddress networking::address;
-ENetHost* networking::server;
+std::vector<ENetHost*> networking::hosts;
+ENetHost* networking::compressed_host = nullptr;
+std::uint64_t networking::tick_ns = 0;
+std::uint64_t networking::bytes_sent = 0;
+std::uint64_t networking::bytes_received = 0;
+std::uint64_t networking::packets_sent = 0;
+std::uint64_t networking::packets_received = 0;
+std::mt19937 networking::rng;
+bool networking::loopback = false;
+std::chrono::steady_clock::time_point networking::event_time;
+std::chrono::steady_clock::time_point networking::last_roster_flush;
 std::vector<room_t> networking::rooms;
-int networking::max_rooms = 6;
 
 void networking::init()
 {
 	networking::address.host = ENET_HOST_ANY;
-	networking::address.port = 23363;
+	networking::address.port = (enet_uint16)config::port;
 	PRINT_INFO("Binding to %u:%u", networking::address.host, networking::address.port);
 
-	server = enet_host_create(&networking::address, 16, 2, 0, 0);
+	auto host = networking::create_host(networking::address);
 
-	if (!server)
+	if (!host)
 	{
 		PRINT_ERROR("Server is invalid");
 		PRINT_ERROR("Shutting down (%i)", 0);
 		global::shutdown = true;
+		return;
+	}
+
+	// Every peer slot is allocated up front, but ENet only scans the first peerCount of them.
+	// Start with a small window and let resize_peer_window widen it as players arrive
+	host->peerCount = config::initial_peers;
+	networking::hosts.emplace_back(host);
+
+	// ENet compresses per host and a client without the model cannot read compressed datagrams,
+	// so clients that speak it opt in by connecting to a port of its own
+	if (config::compression)
+	{
+		auto address = networking::address;
+		address.port = (enet_uint16)(config::compressed_port ? config::compressed_port : config::port + 1);
+
+		host = networking::create_host(address);
+
+		if (host && codec::enable(host, metrics::record_compression))
+		{
+			PRINT_INFO("Compressed traffic on port %u (model %u)", address.port, codec::model_version);
+			host->peerCount = config::initial_peers;
+			networking::compressed_host = host;
+			networking::hosts.emplace_back(host);
+		}
+		else
+		{
+			PRINT_ERROR("Unable to open the compressed port %u", address.port);
+
+			if (host)
+			{
+				enet_host_destroy(host);
+			}
+		}
 	}
 
 	networking::send_webhook("Server has started!");
@@ -30,124 +82,364 @@ void networking::init()
 	});
 }
 
+ENetHost* networking::create_host(const ENetAddress& address)
+{
+	return enet_host_create(&address, config::max_peers, 2, config::host_incoming_bandwidth, config::host_outgoing_bandwidth);
+}
+
 void networking::update()
+{
+	networking::tick_ns = 0;
+
+	// Queued players and roster deltas go out from here, so wake up often enough to keep them on time
+	enet_uint32 timeout = (matchmaker::queued() || config::roster_deltas) ? 100 : 1000;
+
+	// ENet only retransmits and checks peer timeouts inside host service, an idle wait of a full second
+	// would stretch every backoff step of a dead peer to that length
+	for (auto host : networking::hosts)
+	{
+		if (host->connectedPeers)
+		{
+			timeout = std::min<enet_uint32>(timeout, 250);
+		}
+	}
+
+	if (networking::hosts.size() == 1)
+	{
+		networking::service_host(networking::hosts[0], timeout);
+	}
+	else
+	{
+		networking::service_hosts(timeout);
+	}
+
+	networking::event_time = std::chrono::steady_clock::now();
+	capture::record_tick();
+	networking::tick();
+
+	if (networking::tick_ns)
+	{
+		metrics::record_tick(networking::tick_ns);
+	}
+}
+
+// Everything that runs on time rather than on a packet. It only reads event_time, so a replay calling it at
+// the captured ticks makes the same decisions. Congestion goes last, the disconnects it dispatches are captured
+// after the tick and replay in that order
+void networking::tick()
+{
+	networking::flush_rosters();
+	bandwidth::update();
+	matchmaker::update();
+	congestion::update();
+}
+
+void networking::service_hosts(enet_uint32 timeout)
+{
+	// Block until either port has data, then drain each host without waiting on the other.
+	// Peers belong to the host that accepted them, so replies always leave on the client's own socket
+	ENetSocketSet set;
+	ENetSocket max_socket = 0;
+	ENET_SOCKETSET_EMPTY(set);
+
+	for (auto host : networking::hosts)
+	{
+		ENET_SOCKETSET_ADD(set, host->socket);
+		max_socket = std::max(max_socket, host->socket);
+	}
+
+	enet_socketset_select(max_socket, &set, nullptr, timeout);
+
+	for (auto host : networking::hosts)
+	{
+		networking::service_host(host, 0);
+	}
+}
+
+void networking::service_host(ENetHost* host, enet_uint32 timeout)
 {
 	ENetEvent evt;
-	while (enet_host_service(networking::server, &evt, 1000) > 0)
+
+	// Only the first wait blocks, the main loop's periodic updates run again once the backlog is drained
+	while (networking::wait_event(host, &evt, timeout) > 0)
+	{
+		networking::dispatch_event(evt);
+		timeout = 0;
+	}
+
+	networking::resize_peer_window(host);
+	networking::collect_host_totals(host);
+}
+
+int networking::wait_event(ENetHost* host, ENetEvent* evt, enet_uint32 timeout)
+{
+	TRACE_SCOPE("enet_host_service");
+	return enet_host_service(host, evt, timeout);
+}
+
+void networking::collect_host_totals(ENetHost* host)
+{
+	// ENet keeps these as 32 bit counters and expects the user to reset them before they wrap
+	networking::bytes_sent += host->totalSentData;
+	networking::bytes_received += host->totalReceivedData;
+	networking::packets_sent += host->totalSentPackets;
+	networking::packets_received += host->totalReceivedPackets;
+
+	host->totalSentData = 0;
+	host->totalReceivedData = 0;
+	host->totalSentPackets = 0;
+	host->totalReceivedPackets = 0;
+}
+
+void networking::resize_peer_window(ENetHost* host)
+{
+	size_t used = 0;
+
+	for (auto i = 0u; i < host->peerCount; ++i)
+	{
+		if (host->peers[i].state != ENET_PEER_STATE_DISCONNECTED)
+		{
+			used = i + 1;
+		}
+	}
+
+	auto window = host->peerCount;
+
+	// Double once three quarters of the window is taken so a burst of connects never finds it full,
+	// and give slots back once the tail has emptied out
+	if (used * 4 >= window * 3)
+	{
+		window = std::min<size_t>(window * 2, config::max_peers);
+	}
+	else if (used * 4 < window && window > config::initial_peers)
+	{
+		window = std::max<size_t>(std::max<size_t>(used * 2, config::initial_peers), 1);
+	}
+
+	if (window != host->peerCount)
+	{
+		PRINT_DEBUG("Peer window %u -> %u", (unsigned)host->peerCount, (unsigned)window);
+		host->peerCount = window;
+	}
+}
+
+void networking::dispatch_event(ENetEvent& evt)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Replays set the time the event was captured at so time based limits behave as they did live
+	if (!networking::loopback)
+	{
+		networking::event_time = start;
+	}
+
+	recorder::stamp();
+	capture::record(evt);
+	networking::handle_event(evt);
+	networking::tick_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void networking::handle_event(ENetEvent& evt)
+{
+	switch (evt.type)
 	{
-		switch (evt.type)
+		case ENET_EVENT_TYPE_RECEIVE:
 		{
-			case ENET_EVENT_TYPE_RECEIVE:
+			recorder::record(recorder_event_t::RECEIVE, evt.peer, proto_t::NONE, -1, (std::uint32_t)evt.packet->dataLength);
+
+			auto state = networking::get_state(evt.peer);
+
+			if (limiter::admit(evt.peer, state->limits, evt.packet))
 			{
 				networking::handle_packet(evt.packet, evt.peer);
-			} break;
+			}
+
+			enet_packet_destroy(evt.packet);
+		} break;
 
-			case ENET_EVENT_TYPE_CONNECT:
+		case ENET_EVENT_TYPE_CONNECT:
+		{
+			recorder::record(recorder_event_t::CONNECT, evt.peer, proto_t::NONE, -1, evt.peer->address.host);
+			PRINT_DEBUG("Client connected");
+
+			// The disconnect carries the model we speak so the client can update or fall back to the plain port
+			if (evt.peer->host && evt.peer->host == networking::compressed_host && evt.data != codec::model_version)
 			{
-				PRINT_DEBUG("Client connected");
-			} break;
+				PRINT_WARNING("Refusing compression model %u from %s", evt.data, networking::get_ip(evt.peer->address).c_str());
+				enet_peer_disconnect(evt.peer, codec::model_version);
+			}
 
-			case ENET_EVENT_TYPE_DISCONNECT:
+			delete (peer_state_t*)evt.peer->data;
+			evt.peer->data = new peer_state_t();
+
+			if (!networking::loopback)
 			{
-				PRINT_DEBUG("Client disconnected");
+				bandwidth::configure_peer(evt.peer, networking::get_state(evt.peer)->link);
+			}
+		} break;
 
-				int room = -1;
+		case ENET_EVENT_TYPE_DISCONNECT:
+		{
+			recorder::record(recorder_event_t::DISCONNECT, evt.peer);
+			PRINT_DEBUG("Client disconnected");
 
-				for (auto i = 0; i < networking::rooms.size(); ++i)
-				{
-					for (auto j = 0; j < networking::rooms[i].players.size(); ++j)
-					{
-						if (networking::rooms[i].players[j].peer == evt.peer)
-						{
-							room = i;
-							break;
-						}
-					}
-				}
+			auto room = networking::get_room(evt.peer);
 
+			if (room != -1)
+			{
 				networking::remove_user(evt.peer);
+			}
 
-				if (room != -1)
-				{
-					bool delete_room = true;
+			delete (peer_state_t*)evt.peer->data;
+			evt.peer->data = nullptr;
 
-					for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
-					{
-						if (networking::rooms[room].players[i].peer != 0x0)
-						{
-							delete_room = false;
-							break;
-						}
-					}
+			if (room == -1)
+			{
+				return;
+			}
 
-					if (delete_room)
-					{
-						PRINT_INFO("Deleting room \"%s\" due to lack of players!", networking::rooms[room].id.c_str());
-						networking::send_webhook(logger::va("Room `%s` has been deleted.", networking::rooms[room].id.c_str()));
-						networking::rooms.erase(networking::rooms.begin() + room);
-					}
-					else
-					{
-						std::string player_list;
+			if (networking::rooms[room].players.empty())
+			{
+				PRINT_INFO("Deleting room \"%s\" due to lack of players!", networking::rooms[room].id.c_str());
+				recorder::record(recorder_event_t::ROOM_DELETED, evt.peer, proto_t::NONE, room);
+				networking::send_webhook(FORMAT_VA("Room `%s` has been deleted.", networking::rooms[room].id.c_str()));
+				networking::erase_room(room);
+				return;
+			}
 
-						for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
-						{
-							player_list.append(logger::va("%i=%s", i, networking::rooms[room].players[i].name.c_str()));
+			// Clients that take deltas hear about the leave from the next roster flush
+			if (!config::roster_deltas)
+			{
+				networking::room_broadcast_packet(proto_t::GET_USER_LIST, room, networking::get_roster(room));
+			}
 
-							if (i != networking::rooms[room].players.size() - 1)
-							{
-								player_list.append(";");
-							}
-						}
+			if (networking::rooms[room].playing)
+			{
+				networking::check_match_over(room);
+			}
+			else
+			{
+				networking::check_all_ready(room);
+			}
+		} break;
+	}
+}
 
-						networking::room_broadcast_packet(proto_t::GET_USER_LIST, room, player_list);
-					}
-				}
-				else
-				{
-					if (room == -1)
-					{
-						return;
-					}
+void networking::send_packet(proto_t proto, ENetPeer* peer, const std::string& info, enet_uint32 flags)
+{
+	auto packet = networking::create_packet(proto, info, flags);
 
-					if (networking::rooms[room].playing)
-					{
-						if (auto winner = networking::check_winner(room) != -1)
-						{
-							networking::room_broadcast_packet(
-								proto_t::GRANT_WINNER,
-								room,
-								logger::va("winner=%s;", networking::rooms[room].players[winner].name)
-							);
+	recorder::record(recorder_event_t::SEND, peer, proto, -1, (std::uint32_t)packet->dataLength);
+	metrics::record_send(proto, packet->dataLength);
 
-							networking::rooms[room].playing = false;
-						}
-					}
-					else
-					{
-						networking::check_all_ready(room);
-					}
-				}
-			} break;
-		}
-	}
+	networking::send_to_peer(peer, proto, packet);
+	congestion::release(packet);
 }
 
-void networking::send_packet(proto_t proto, ENetPeer* peer, const std::string& info)
+ENetPacket* networking::create_packet(proto_t proto, const std::string& info, enet_uint32 flags)
 {
-	std::string final_info = logger::va("proto=%i;", proto).append(info);
-	ENetPacket* packet = enet_packet_create(final_info.c_str(), final_info.size() + 1, ENET_PACKET_FLAG_RELIABLE);
-	enet_peer_send(peer, 0, packet);
+	std::string final_info = FORMAT_VA("proto=%i;", proto).append(info);
+	return enet_packet_create(final_info.c_str(), final_info.size() + 1, flags);
+}
+
+// Queues the packet for the peer without giving up ownership, the caller releases it once every peer has it
+void networking::send_to_peer(ENetPeer* peer, proto_t proto, ENetPacket* packet)
+{
+	if (networking::loopback)
+	{
+		// Replays have no sockets, account for what would have gone out
+		++networking::packets_sent;
+		networking::bytes_sent += packet->dataLength;
+		return;
+	}
+
+	congestion::send(peer, networking::get_state(peer)->queue, proto, packet);
 }
 
 void networking::room_broadcast_packet(proto_t proto, int room, const std::string& info)
 {
+	TRACE_SCOPE("room_broadcast_packet", networking::get_proto_name(proto));
+	metrics::record_broadcast(proto, networking::rooms[room].players.size());
+
+	// Once the room has spent its budget only traffic that has to arrive stays reliable
+	auto bytes = (info.size() + 16) * networking::rooms[room].players.size();
+	enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE;
+
+	if (!bandwidth::charge_room(networking::rooms[room], bytes) && congestion::get_delivery(proto) != delivery_t::CRITICAL)
+	{
+		flags = 0;
+	}
+
+	// Encoded once, every player's queue references the same packet and ENet frees it after the last ack
+	auto packet = networking::create_packet(proto, info, flags);
+	metrics::record_send(proto, packet->dataLength, networking::rooms[room].players.size());
+
 	for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
 	{
 		auto peer = networking::rooms[room].players[i].peer;
 
-		networking::send_packet(proto, peer, info);
+		if (peer)
+		{
+			recorder::record(recorder_event_t::SEND, peer, proto, room, (std::uint32_t)packet->dataLength);
+			networking::send_to_peer(peer, proto, packet);
+		}
 	}
+
+	congestion::release(packet);
+}
+
+const char* networking::get_proto_name(proto_t proto)
+{
+	switch (proto)
+	{
+		case proto_t::CREATE_ROOM: return "CREATE_ROOM";
+		case proto_t::NEW_USER: return "NEW_USER";
+		case proto_t::READY_UP: return "READY_UP";
+		case proto_t::START_GAME: return "START_GAME";
+		case proto_t::GET_USER_LIST: return "GET_USER_LIST";
+		case proto_t::USE_POWEWRUP: return "USE_POWEWRUP";
+		case proto_t::DIED: return "DIED";
+		case proto_t::NAME_CHANGE: return "NAME_CHANGE";
+		case proto_t::GET_LEVEL_LIST: return "GET_LEVEL_LIST";
+		case proto_t::ROOMS_FULL: return "ROOMS_FULL";
+		case proto_t::ALREADY_IN_GAME: return "ALREADY_IN_GAME";
+		case proto_t::CHECK_SERVER_ALIVE: return "CHECK_SERVER_ALIVE";
+		case proto_t::INVALID_KEY: return "INVALID_KEY";
+		case proto_t::GRANT_WINNER: return "GRANT_WINNER";
+		case proto_t::MATCH_START: return "MATCH_START";
+		case proto_t::CLOCK_SYNC: return "CLOCK_SYNC";
+		case proto_t::MATCHMAKE: return "MATCHMAKE";
+		case proto_t::GET_ROOM_LIST: return "GET_ROOM_LIST";
+		case proto_t::ROSTER_UPDATE: return "ROSTER_UPDATE";
+		case proto_t::SCORE_UPDATE: return "SCORE_UPDATE";
+		case proto_t::START_ACK: return "START_ACK";
+	}
+
+	return "UNKNOWN";
+}
+
+std::uint16_t networking::get_host_index(ENetHost* host)
+{
+	for (auto i = 0u; i < networking::hosts.size(); ++i)
+	{
+		if (networking::hosts[i] == host)
+		{
+			return (std::uint16_t)i;
+		}
+	}
+
+	return 0xFFFF;
+}
+
+peer_state_t* networking::get_state(ENetPeer* peer)
+{
+	// Normally created on connect, replays can start with peers whose connect was never captured
+	if (!peer->data)
+	{
+		peer->data = new peer_state_t();
+	}
+
+	return (peer_state_t*)peer->data;
 }
 
 std::string networking::get_ip(ENetAddress address)
@@ -159,42 +451,48 @@ std::string networking::get_ip(ENetAddress address)
 
 void networking::cleanup()
 {
-	enet_host_destroy(networking::server);
+	for (auto host : networking::hosts)
+	{
+		host->peerCount = config::max_peers;
+
+		for (auto i = 0u; i < host->peerCount; ++i)
+		{
+			delete (peer_state_t*)host->peers[i].data;
+			host->peers[i].data = nullptr;
+		}
+
+		enet_host_destroy(host);
+	}
+
+	networking::hosts.clear();
+	networking::compressed_host = nullptr;
+	browser::cleanup();
 	networking::rooms.clear();
 }
 
 bool networking::create_room(const std::string& roomid, const std::string& key)
 {
-	if (networking::rooms.size() > networking::max_rooms)
+	if (networking::rooms.size() > config::max_rooms)
 	{
 		PRINT_ERROR("Room limit reached!");
 		return false;
 	}
 
-	bool exists = false;
-
-	for (auto i = 0; i < networking::rooms.size(); ++i)
-	{
-		if (networking::rooms[i].id == roomid)
-		{
-			exists = true;
-			break;
-		}
-	}
-
-	if (!exists)
+	if (networking::find_room(roomid) == -1)
 	{
 		room_t new_room;
 		new_room.id = roomid;
 		new_room.key = key;
 		networking::rooms.emplace_back(new_room);
+		recorder::record(recorder_event_t::ROOM_CREATED, nullptr, proto_t::NONE, (int)networking::rooms.size() - 1);
+		networking::room_changed((int)networking::rooms.size() - 1);
 
 		PRINT_INFO("New Room Created: \"%s\"", roomid.c_str());
 
 		std::string status = "Private";
 		if (key == "_") status = "Public";
 
-		networking::send_webhook(logger::va("%s room `%s` has been created", status.c_str(), roomid.c_str()));
+		networking::send_webhook(FORMAT_VA("%s room `%s` has been created", status.c_str(), roomid.c_str()));
 	}
 	else
 	{
@@ -212,38 +510,52 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 
 	if (split_packet[0].find("proto") != std::string::npos)
 	{
-		proto = (proto_t)std::stoi(logger::split(split_packet[0], "=")[1]);
+		try
+		{
+			proto = (proto_t)std::stoi(logger::split(split_packet[0], "=").at(1));
+		}
+		catch (...)
+		{
+			recorder::record(recorder_event_t::PARSE_FAILURE, peer, proto_t::NONE, -1, (std::uint32_t)packet->dataLength);
+			metrics::record_parse_failure(packet->dataLength);
+			PRINT_ERROR("Malformed protocol information!");
+			return;
+		}
 	}
 	else
 	{
+		recorder::record(recorder_event_t::PARSE_FAILURE, peer, proto_t::NONE, -1, (std::uint32_t)packet->dataLength);
+		metrics::record_parse_failure(packet->dataLength);
 		PRINT_ERROR("Unable to find protocol information!");
 		return;
 	}
 
+	metrics::scope scope(proto, packet->dataLength);
+	TRACE_SCOPE("handle_packet", networking::get_proto_name(proto));
+	recorder::record(recorder_event_t::HANDLE, peer, proto);
+
 	if (proto != proto_t::NONE)
 	{
 		switch (proto)
 		{
 			case proto_t::READY_UP:
 			{
-				int room = -1;
+				auto room = networking::get_room(peer);
 
-				for (auto i = 0; i < networking::rooms.size(); ++i)
+				if (room == -1)
 				{
-					for (auto j = 0; j < networking::rooms[i].players.size(); ++j)
-					{
-						if (networking::rooms[i].players[j].peer == peer && !networking::rooms[i].players[j].ready)
-						{
-							networking::rooms[i].players[j].ready = true;
-							room = i;
-							break;
-						}
-					}
+					return;
 				}
 
-				networking::check_all_ready(room);
-			} break;
+				auto& player = networking::rooms[room].players[networking::get_user_index(peer, room)];
 
+				if (!player.ready)
+				{
+					player.ready = true;
+					++networking::rooms[room].ready_count;
+					networking::check_all_ready(room);
+				}
+			} break;
 
 			case proto_t::CREATE_ROOM:
 			{
@@ -273,19 +585,20 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 			case proto_t::DIED:
 			{
 				auto room = networking::get_room(peer);
-				auto player = networking::get_user_index(peer, room);
 
-				networking::rooms[room].players[player].alive = false;
-
-				if (auto winner = networking::check_winner(room) != -1)
+				if (!recorder::check(room != -1, "DIED from a peer that is not in a room", peer, proto))
 				{
-					networking::room_broadcast_packet(
-						proto_t::GRANT_WINNER,
-						room,
-						logger::va("winner=%s;", networking::rooms[room].players[winner].name)
-					);
+					return;
+				}
 
-					networking::rooms[room].playing = false;
+				auto& player = networking::rooms[room].players[networking::get_user_index(peer, room)];
+
+				if (networking::rooms[room].playing && player.alive)
+				{
+					player.alive = false;
+					--networking::rooms[room].alive_count;
+					targeting::eliminate(room, networking::get_user_index(peer, room));
+					networking::check_match_over(room);
 				}
 			} break;
 
@@ -313,17 +626,16 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 					}
 				}
 
-				if (roomid != "" && key != "" && name != "")
+				if (networking::get_room(peer) != -1)
 				{
-					if (name.size() > 12)
-					{
-						name = name.substr(0, 12);
-					}
+					PRINT_WARNING("Player \"%s\" is already in a room", name.c_str());
+					return;
+				}
 
+				if (roomid != "" && key != "" && name != "")
+				{
 					for (auto i = 0; i < networking::rooms.size(); ++i)
 					{
-						int user_exists = 0;
-
 						if (networking::rooms[i].id == roomid)
 						{
 							if (networking::rooms[i].key != key && networking::rooms[i].key != "_")
@@ -338,39 +650,13 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 								return;
 							}
 
-						retry:
-							for (auto j = 0; j < networking::rooms[i].players.size(); ++j)
+							if (networking::rooms[i].players.size() >= config::room_capacity)
 							{
-								if (!user_exists)
-								{
-									if (name == networking::rooms[i].players[j].name)
-									{
-										++user_exists;
-										goto retry;
-									}
-								}
-								else
-								{
-									if ((name + logger::va("-%i", user_exists)) == networking::rooms[i].players[j].name)
-									{
-										++user_exists;
-										goto retry;
-									}
-								}
+								networking::send_packet(proto_t::ROOMS_FULL, peer);
+								return;
 							}
 
-							
-							player_t new_player;
-							new_player.peer = peer;
-
-							if(!user_exists) new_player.name = name;
-							else if(user_exists) new_player.name = (name + logger::va("-%i", user_exists));
-
-							PRINT_INFO("Adding new player \"%s\"", new_player.name.c_str());
-
-
-							networking::rooms[i].players.emplace_back(new_player);
-							networking::send_packet(proto_t::NAME_CHANGE, peer, logger::va("name=%s", new_player.name.c_str()));
+							networking::join_room(peer, i, name);
 							break;
 						}
 					}
@@ -384,42 +670,39 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 
 			case proto_t::USE_POWEWRUP:
 			{
-				PRINT_DEBUG("%s", packet->data);
-				powerup_t powerup;
-				std::string attacking;
+				PRINT_DEBUG("%s", (const char*)packet->data);
+				auto room = networking::get_room(peer);
 
-				for (auto i = 1; i < split_packet.size(); ++i)
+				if (!recorder::check(room != -1, "USE_POWEWRUP from a peer that is not in a room", peer, proto))
 				{
-					if (split_packet[i].find("powerup") != std::string::npos)
-					{
-						powerup = (powerup_t)std::stoi(logger::split(split_packet[i], "=")[1]);
-						continue;
-					}
-					else if (split_packet[i].find("attacking") != std::string::npos)
-					{
-						attacking = logger::split(split_packet[i], "=")[1];
-						continue;
-					}
+					return;
 				}
 
-				if (attacking == "")
+				targeting::handle(peer, room, split_packet);
+			} break;
+
+			case proto_t::SCORE_UPDATE:
+			{
+				auto room = networking::get_room(peer);
+
+				if (!recorder::check(room != -1, "SCORE_UPDATE from a peer that is not in a room", peer, proto))
 				{
-					PRINT_ERROR("Did not find attacking user!");
 					return;
 				}
 
+				targeting::handle_score(peer, room, split_packet);
+			} break;
+
+			case proto_t::START_ACK:
+			{
 				auto room = networking::get_room(peer);
-				auto username = networking::get_username(peer, room);
 
-				for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
+				if (!recorder::check(room != -1, "START_ACK from a peer that is not in a room", peer, proto))
 				{
-					if (networking::rooms[room].players[i].name == attacking)
-					{
-						std::string msg = logger::va("powerup=%i;user=%s;", (int)powerup, username.c_str());
-						networking::send_packet(proto_t::USE_POWEWRUP, peer, msg);
-						break;
-					}
+					return;
 				}
+
+				timesync::handle_start(peer, room, split_packet);
 			} break;
 
 			case proto_t::CHECK_SERVER_ALIVE:
@@ -427,9 +710,23 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 				networking::send_packet(proto_t::CHECK_SERVER_ALIVE, peer);
 			} break;
 
+			case proto_t::CLOCK_SYNC:
+			{
+				timesync::handle(peer, split_packet);
+			} break;
+
+			case proto_t::MATCHMAKE:
+			{
+				matchmaker::handle(peer, split_packet);
+			} break;
+
+			case proto_t::GET_ROOM_LIST:
+			{
+				browser::handle(peer, split_packet);
+			} break;
+
 			case proto_t::GET_USER_LIST:
 			{
-				std::string player_list;
 				int room = networking::get_room(peer);
 
 				if (room == -1)
@@ -438,17 +735,7 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 					return;
 				}
 
-				for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
-				{
-					player_list.append(logger::va("%i=%s", i, networking::rooms[room].players[i].name.c_str()));
-
-					if (i != networking::rooms[room].players.size() - 1)
-					{
-						player_list.append(";");
-					}
-				}
-
-				networking::send_packet(proto_t::GET_USER_LIST, peer, player_list);
+				networking::send_packet(proto_t::GET_USER_LIST, peer, networking::get_roster(room));
 			} break;
 		}
 	}
@@ -456,78 +743,295 @@ void networking::handle_packet(ENetPacket* packet, ENetPeer* peer)
 
 void networking::remove_user(ENetPeer* peer)
 {
-	bool removed = false;
-	std::string name;
+	auto state = networking::get_state(peer);
+	auto room = state->room;
 
-	for (auto i = 0; i < networking::rooms.size(); ++i)
+	if (room == -1)
 	{
-		for (auto j = 0; j < networking::rooms[i].players.size(); ++j)
-		{
-			if (networking::rooms[i].players[j].peer == peer)
-			{
-				name = networking::rooms[i].players[j].name;
-				networking::rooms[i].players.erase(networking::rooms[i].players.begin() + j);
-				removed = true;
-				break;
-			}
-		}
+		PRINT_ERROR("Unable to remove player");
+		return;
 	}
 
-	if (!removed)
+	auto& entry = networking::rooms[room];
+	auto index = state->player;
+	auto& player = entry.players[index];
+
+	recorder::record(recorder_event_t::LEAVE, peer, proto_t::NONE, room, index);
+	PRINT_DEBUG("Player \"%s\" removed", player.name.c_str());
+
+	entry.ready_count -= player.ready;
+	entry.alive_count -= entry.playing && player.alive;
+	networking::queue_roster_change(room, "leave", player.name);
+	targeting::remove_player(room, index);
+	networking::release_name(room, player.name);
+
+	// The last player takes the free spot so nobody else's index moves
+	if (index != (int)entry.players.size() - 1)
 	{
-		PRINT_ERROR("Unable to remove player");
+		player = std::move(entry.players.back());
+		networking::get_state(player.peer)->player = index;
+	}
+
+	entry.players.pop_back();
+	entry.roster_stale = true;
+	state->room = -1;
+	state->player = -1;
+
+	networking::room_changed(room);
+}
+
+void networking::join_room(ENetPeer* peer, int room, std::string name)
+{
+	if (name.size() > config::max_name_length)
+	{
+		name = name.substr(0, config::max_name_length);
+	}
+
+	player_t new_player;
+	new_player.peer = peer;
+	new_player.name = networking::claim_name(room, name);
+
+	PRINT_INFO("Adding new player \"%s\"", new_player.name.c_str());
+
+	auto state = networking::get_state(peer);
+	state->room = room;
+	state->player = (int)networking::rooms[room].players.size();
+
+	networking::queue_roster_change(room, "join", new_player.name);
+	networking::rooms[room].names.emplace(new_player.name, peer);
+	networking::rooms[room].players.emplace_back(new_player);
+	networking::room_changed(room);
+
+	// Joins only ever add to the end, so a fresh roster grows in place instead of being rendered again
+	if (!networking::rooms[room].roster_stale)
+	{
+		FORMAT_APPEND(networking::rooms[room].roster, "%s%i=%s", state->player ? ";" : "", state->player, new_player.name.c_str());
+	}
+	recorder::record(recorder_event_t::JOIN, peer, proto_t::NEW_USER, room, (std::uint32_t)networking::rooms[room].players.size() - 1);
+	networking::send_packet(proto_t::NAME_CHANGE, peer, FORMAT_VA("name=%s", new_player.name.c_str()));
+
+	// Deltas only make sense on top of a full roster
+	if (config::roster_deltas)
+	{
+		networking::send_packet(proto_t::GET_USER_LIST, peer, networking::get_roster(room));
+	}
+}
+
+// The name itself if it is free, otherwise name-k for the smallest k that is. Every suffix below a base's
+// hint is known to be taken, so the search starts there rather than at 1
+std::string networking::claim_name(int room, const std::string& name)
+{
+	auto& entry = networking::rooms[room];
+
+	if (!entry.names.count(name))
+	{
+		return name;
+	}
+
+	auto hint = entry.name_hints.find(name);
+	auto suffix = hint != entry.name_hints.end() ? hint->second : 1;
+	auto candidate = name + "-" + std::to_string(suffix);
+
+	while (entry.names.count(candidate))
+	{
+		candidate = name + "-" + std::to_string(++suffix);
+	}
+
+	entry.name_hints[name] = suffix + 1;
+	return candidate;
+}
+
+void networking::release_name(int room, const std::string& name)
+{
+	auto& entry = networking::rooms[room];
+	entry.names.erase(name);
+
+	// A freed name-k is the first free suffix for its base again if it sits below the hint
+	auto dash = name.rfind('-');
+
+	if (dash == std::string::npos || dash + 1 == name.size() || name[dash + 1] == '0' || name.size() - dash > 10)
+	{
+		return;
+	}
+
+	if (name.find_first_not_of("0123456789", dash + 1) != std::string::npos)
+	{
+		return;
+	}
+
+	auto hint = entry.name_hints.find(name.substr(0, dash));
+	auto suffix = std::atoi(name.c_str() + dash + 1);
+
+	if (hint == entry.name_hints.end() || suffix >= hint->second)
+	{
+		return;
+	}
+
+	if (suffix == 1)
+	{
+		entry.name_hints.erase(hint);
 	}
 	else
 	{
-		PRINT_DEBUG("Player \"%s\" removed", name.c_str());
+		hint->second = suffix;
 	}
 }
 
-std::string networking::get_username(ENetPeer* peer, int room)
+// Keeps every index that describes a room in step with its roster and state
+void networking::room_changed(int room)
 {
-	for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
+	matchmaker::update_room(room);
+	browser::touch(room);
+}
+
+void networking::erase_room(int room)
+{
+	matchmaker::erase_room(room);
+	browser::erase_room(room);
+	networking::rooms.erase(networking::rooms.begin() + room);
+
+	// Rooms after the erased one moved down a slot, their players' indexes follow
+	for (auto i = room; i < (int)networking::rooms.size(); ++i)
 	{
-		if (networking::rooms[room].players[i].peer == peer)
+		for (auto& player : networking::rooms[i].players)
 		{
-			return networking::rooms[room].players[i].name;
+			networking::get_state(player.peer)->room = i;
 		}
 	}
+}
 
-	return "UNKNOWN";
+// Serialized once per change, polling clients and leave broadcasts all reuse it
+const std::string& networking::get_roster(int room)
+{
+	auto& entry = networking::rooms[room];
+
+	if (entry.roster_stale)
+	{
+		entry.roster.clear();
+
+		if (config::roster_deltas)
+		{
+			FORMAT_APPEND(entry.roster, "seq=%u;", entry.roster_seq);
+		}
+
+		for (auto i = 0; i < entry.players.size(); ++i)
+		{
+			FORMAT_APPEND(entry.roster, "%i=%s", i, entry.players[i].name.c_str());
+
+			if (i != entry.players.size() - 1)
+			{
+				entry.roster.append(";");
+			}
+		}
+
+		entry.roster_stale = false;
+	}
+
+	return entry.roster;
 }
 
-int networking::get_user_index(ENetPeer* peer, int room)
+void networking::queue_roster_change(int room, const char* change, const std::string& name)
 {
-	for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
+	if (config::roster_deltas)
+	{
+		FORMAT_APPEND(networking::rooms[room].roster_delta, "%s=%s;", change, name.c_str());
+	}
+}
+
+void networking::flush_rosters()
+{
+	auto now = networking::event_time;
+
+	if (!config::roster_deltas || now - networking::last_roster_flush < std::chrono::milliseconds(config::roster_interval))
+	{
+		return;
+	}
+
+	networking::last_roster_flush = now;
+
+	// However many players come and go, a room gets at most one roster broadcast per interval
+	for (auto i = 0; i < (int)networking::rooms.size(); ++i)
 	{
-		if (networking::rooms[room].players[i].peer == peer)
+		auto& entry = networking::rooms[i];
+
+		if (entry.roster_delta.empty())
 		{
-			return i;
+			continue;
 		}
+
+		++entry.roster_seq;
+		entry.roster_stale = true;
+
+		networking::room_broadcast_packet(
+			proto_t::ROSTER_UPDATE,
+			i,
+			FORMAT_VA("seq=%u;players=%i;", entry.roster_seq, (int)entry.players.size()).append(entry.roster_delta)
+		);
+
+		entry.roster_delta.clear();
+	}
+}
+
+void networking::check_match_over(int room)
+{
+	auto& entry = networking::rooms[room];
+	auto winner = networking::check_winner(room);
+
+	if (winner != -1)
+	{
+		networking::room_broadcast_packet(proto_t::GRANT_WINNER, room, FORMAT_VA("winner=%s;", entry.players[winner].name.c_str()));
+		recorder::record(recorder_event_t::WINNER, nullptr, proto_t::NONE, room, winner);
+	}
+	else if (entry.alive_count > 0)
+	{
+		return;
+	}
+	else
+	{
+		// The last two went out together or the survivor left, nobody is left to crown
+		PRINT_INFO("Match in room \"%s\" ended without a winner", entry.id.c_str());
 	}
 
-	return -1;
+	entry.playing = false;
+	timesync::close_report(room);
+	targeting::end_match(room);
+	networking::room_changed(room);
+}
+
+std::string networking::get_username(ENetPeer* peer, int room)
+{
+	auto index = networking::get_user_index(peer, room);
+	return index != -1 ? networking::rooms[room].players[index].name : "UNKNOWN";
+}
+
+int networking::get_user_index(ENetPeer* peer, int room)
+{
+	auto state = networking::get_state(peer);
+	return state->room == room ? state->player : -1;
 }
 
 int networking::get_room(ENetPeer* peer)
 {
-	int room = -1;
+	return networking::get_state(peer)->room;
+}
+
+int networking::find_room(const std::string& roomid)
+{
 	for (auto i = 0; i < networking::rooms.size(); ++i)
 	{
-		for (auto j = 0; j < networking::rooms[i].players.size(); ++j)
+		if (networking::rooms[i].id == roomid)
 		{
-			if (networking::rooms[i].players[j].peer == peer)
-			{
-				room = i;
-				break;
-			}
+			return i;
 		}
 	}
-	return room;
+
+	return -1;
 }
 
 void networking::check_all_ready(int room)
 {
+	TRACE_SCOPE("check_all_ready");
+
 	if (room == -1)
 	{
 		return;
@@ -548,18 +1052,7 @@ void networking::check_all_ready(int room)
 		return;
 	}
 
-	bool all_ready = true;
-
-	for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
-	{
-		if (!networking::rooms[room].players[i].ready)
-		{
-			all_ready = false;
-			break;
-		}
-	}
-
-	if (all_ready)
+	if (networking::rooms[room].ready_count == (int)networking::rooms[room].players.size())
 	{
 		PRINT_INFO("Starting game in room \"%s\"", networking::rooms[room].id.c_str());
 		int max_levels = 50;
@@ -568,7 +1061,7 @@ void networking::check_all_ready(int room)
 
 		for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
 		{
-			player_list.append(logger::va("%i=%s", i, networking::rooms[room].players[i].name.c_str()));
+			FORMAT_APPEND(player_list, "%i=%s", i, networking::rooms[room].players[i].name.c_str());
 
 			if (i != networking::rooms[room].players.size() - 1)
 			{
@@ -576,27 +1069,25 @@ void networking::check_all_ready(int room)
 			}
 		}
 
-		static std::random_device rd;
-		static std::mt19937 mt(rd());
 		static std::uniform_int_distribution stage_1(1, 5);
 		static std::uniform_int_distribution stage_2(6, 10);
 		static std::uniform_int_distribution stage_3(11, 15);
 
-		level_list.append("0=0");
+		level_list.append("0=0;");
 
 		for (auto i = 1; i < max_levels; ++i)
 		{
 			if (i < 3)
 			{
-				level_list.append(logger::va("%i=%i", i, stage_1(mt)));
+				FORMAT_APPEND(level_list, "%i=%i", i, stage_1(networking::rng));
 			}
 			else if (i >= 3 && i < 10)
 			{
-				level_list.append(logger::va("%i=%i", i, stage_2(mt)));
+				FORMAT_APPEND(level_list, "%i=%i", i, stage_2(networking::rng));
 			}
 			else if (i >= 10 && i < max_levels)
 			{
-				level_list.append(logger::va("%i=%i", i, stage_3(mt)));
+				FORMAT_APPEND(level_list, "%i=%i", i, stage_3(networking::rng));
 			}
 
 			if (i != max_levels - 1)
@@ -605,36 +1096,90 @@ void networking::check_all_ready(int room)
 			}
 		}
 
-		networking::room_broadcast_packet(proto_t::GET_USER_LIST, room, player_list);
-		networking::room_broadcast_packet(proto_t::GET_LEVEL_LIST, room, level_list);
-		networking::room_broadcast_packet(proto_t::START_GAME, room);
+		// Clients that have synced their clock hold the start until start_at, older ones ignore the field and start on arrival
+		auto start_at = timesync::schedule_start(room);
+
+		if (config::match_start_bundle)
+		{
+			networking::room_broadcast_packet(proto_t::MATCH_START, room, networking::build_match_start(room, player_list, level_list, start_at));
+		}
+		else
+		{
+			networking::room_broadcast_packet(proto_t::GET_USER_LIST, room, player_list);
+			networking::room_broadcast_packet(proto_t::GET_LEVEL_LIST, room, level_list);
+			networking::room_broadcast_packet(proto_t::START_GAME, room, FORMAT_VA("start_at=%llu;", (unsigned long long)start_at));
+		}
+
+		timesync::open_report(room, start_at);
+		matchmaker::report_match(room);
+
 		networking::rooms[room].playing = true;
+		networking::room_changed(room);
+		recorder::record(recorder_event_t::MATCH_START, nullptr, proto_t::NONE, room, (std::uint32_t)networking::rooms[room].players.size());
 
 		for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
 		{
 			networking::rooms[room].players[i].ready = false;
+			networking::rooms[room].players[i].alive = true;
 		}
 
+		networking::rooms[room].ready_count = 0;
+		networking::rooms[room].alive_count = (int)networking::rooms[room].players.size();
+		targeting::start_match(room);
+
 		networking::send_webhook(
-			logger::va(
+			FORMAT_VA(
 				"Room `%s` has started a match with `%i` players",
 				networking::rooms[room].id.c_str(),
-				networking::rooms[room].players.size()
+				(int)networking::rooms[room].players.size()
 			)
 		);
 	}
 }
 
+// Roster, levels and start parameters in one reliable packet so a client either has the whole start or none of it.
+// Entries keep their index=value form, prefixed so both lists fit in the same key=value message
+std::string networking::build_match_start(int room, const std::string& player_list, const std::string& level_list, std::uint64_t start_at)
+{
+	std::string bundle;
+	bundle.reserve(player_list.size() + level_list.size() + 64);
+
+	auto append_list = [&](const char* prefix, const std::string& list)
+	{
+		for (auto& entry : logger::split(list, ";"))
+		{
+			if (!entry.empty())
+			{
+				bundle.append(prefix).append(entry).append(";");
+			}
+		}
+	};
+
+	FORMAT_APPEND(bundle, "start_at=%llu;players=%i;", (unsigned long long)start_at, (int)networking::rooms[room].players.size());
+	append_list("p", player_list);
+	FORMAT_APPEND(bundle, "levels=%i;", (int)std::count(level_list.begin(), level_list.end(), ';') + 1);
+	append_list("l", level_list);
+
+	return bundle;
+}
+
 void networking::send_webhook(const std::string& message)
 {
-	std::string final_message = logger::va("{\"content\": \"%s\"}", message.c_str());
+	TRACE_SCOPE("send_webhook");
+
+	if (networking::loopback)
+	{
+		return;
+	}
+
+	std::string final_message = FORMAT_VA("{\"content\": \"%s\"}", message.c_str());
 
 	httplib::Client cli("https://discordapp.com");
 
 	if (
 		auto res = cli.Post(
 			"/api/webhooks/1001161950056689744/TjefYaDy6rS5VUa3IzblX5XU1ZpMDFWT1WuBO-v3N2k9nB2IyACtRmO5-Ia8jchMMkdx",
-			logger::va("{\"content\": \"%s\"}", message.c_str()).c_str(),
+			FORMAT_VA("{\"content\": \"%s\"}", message.c_str()).c_str(),
 			"application/json"
 		)
 	)
@@ -645,23 +1190,19 @@ void networking::send_webhook(const std::string& message)
 
 int networking::check_winner(int room)
 {
-	int winner = -1;
+	// Only the last survivor needs finding, so the scan runs once per match rather than once per death
+	if (networking::rooms[room].alive_count != 1)
+	{
+		return -1;
+	}
 
 	for (auto i = 0; i < networking::rooms[room].players.size(); ++i)
 	{
 		if (networking::rooms[room].players[i].alive)
 		{
-			if (winner == -1)
-			{
-				winner = i;
-			}
-			else if (winner != -1)
-			{
-				winner = -1;
-				break;
-			}
+			return i;
 		}
 	}
 
-	return winner;
+	return -1;
 }
@@ -1,5 +1,13 @@
 #pragma once
 
+#include "limiter/limiter.hpp"
+#include "congestion/congestion.hpp"
+#include "bandwidth/bandwidth.hpp"
+#include "matchmaker/matchmaker.hpp"
+#include "browser/browser.hpp"
+#include "targeting/targeting.hpp"
+#include "timesync/timesync.hpp"
+
 enum class proto_t
 {
 	NONE = -1,
@@ -17,15 +25,38 @@ enum class proto_t
 	CHECK_SERVER_ALIVE,
 	INVALID_KEY,
 	GRANT_WINNER,
+	MATCH_START,
+	CLOCK_SYNC,
+	MATCHMAKE,
+	GET_ROOM_LIST,
+	ROSTER_UPDATE,
+	SCORE_UPDATE,
+	START_ACK,
 };
 
 struct player_t
 {
 	ENetPeer* peer;
 	std::string name = "N/A";
-	std::string attacking;
 	bool ready = false;
 	bool alive = false;
+	bool started = false;
+	player_targets_t targets;
+};
+
+// Hung off ENetPeer::data for the lifetime of the connection
+struct peer_state_t
+{
+	peer_limits_t limits;
+	peer_queue_t queue;
+	peer_link_t link;
+
+	// Non-zero while the peer waits in the matchmaking queue
+	std::uint32_t matchmaking_ticket = 0;
+
+	// Where the peer sits, kept up to date as rooms and players move so lookups never scan
+	int room = -1;
+	int player = -1;
 };
 
 struct room_t
@@ -33,6 +64,24 @@ struct room_t
 	std::string id, key;
 	std::vector<player_t> players;
 	bool playing = false;
+	int ready_count = 0;
+	int alive_count = 0;
+	token_bucket_t budget;
+	room_seats_t seats;
+	listing_entry_t listing;
+	room_targets_t targets;
+	start_report_t start_report;
+
+	// Every name in the room, and the first suffix worth trying for a base name that is taken
+	std::unordered_map<std::string, ENetPeer*> names;
+	std::unordered_map<std::string, int> name_hints;
+
+	std::string roster;
+	bool roster_stale = true;
+
+	// Joins and leaves since the last ROSTER_UPDATE, applying them twice is harmless
+	std::string roster_delta;
+	std::uint32_t roster_seq = 0;
 };
 
 class networking final
@@ -40,24 +89,58 @@ class networking final
 public:
 	static void init();
 	static void update();
+	static void tick();
+	static void service_hosts(enet_uint32 timeout);
+	static void service_host(ENetHost* host, enet_uint32 timeout);
+	static void dispatch_event(ENetEvent& evt);
+	static void handle_event(ENetEvent& evt);
 	static void cleanup();
-	static void send_packet(proto_t proto, ENetPeer* peer, const std::string& info = "");
+	static void send_packet(proto_t proto, ENetPeer* peer, const std::string& info = "", enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE);
+	static ENetPacket* create_packet(proto_t proto, const std::string& info, enet_uint32 flags = ENET_PACKET_FLAG_RELIABLE);
+	static void send_to_peer(ENetPeer* peer, proto_t proto, ENetPacket* packet);
 	static void room_broadcast_packet(proto_t proto, int room, const std::string& info = "");
 	static void handle_packet(ENetPacket* packet, ENetPeer* peer);
+	static bool create_room(const std::string& roomid, const std::string& key);
+	static void join_room(ENetPeer* peer, int room, std::string name);
+	static std::string claim_name(int room, const std::string& name);
+	static void release_name(int room, const std::string& name);
+	static void room_changed(int room);
+	static void erase_room(int room);
+	static const std::string& get_roster(int room);
+	static void queue_roster_change(int room, const char* change, const std::string& name);
+	static void flush_rosters();
+	static void check_match_over(int room);
 	static void remove_user(ENetPeer* peer);
 	static std::string get_username(ENetPeer* peer, int room);
 	static int get_user_index(ENetPeer* peer, int room);
 	static int get_room(ENetPeer* peer);
+	static int find_room(const std::string& roomid);
 	static std::string get_ip(ENetAddress address);
+	static const char* get_proto_name(proto_t proto);
+	static std::uint16_t get_host_index(ENetHost* host);
+	static peer_state_t* get_state(ENetPeer* peer);
 	static void send_webhook(const std::string& message);
 	static void check_all_ready(int room);
+	static std::string build_match_start(int room, const std::string& player_list, const std::string& level_list, std::uint64_t start_at);
 	static int check_winner(int room);
 
 	static std::vector<room_t> rooms;
 	static ENetAddress address;
-	static ENetHost* server;
-	static int max_rooms;
+	static std::vector<ENetHost*> hosts;
+	static ENetHost* compressed_host;
+	static std::uint64_t tick_ns;
+	static std::uint64_t bytes_sent;
+	static std::uint64_t bytes_received;
+	static std::uint64_t packets_sent;
+	static std::uint64_t packets_received;
+	static std::mt19937 rng;
+	static bool loopback;
+	static std::chrono::steady_clock::time_point event_time;
+	static std::chrono::steady_clock::time_point last_roster_flush;
 
 private:
-	static bool create_room(const std::string& roomid, const std::string& key);
+	static ENetHost* create_host(const ENetAddress& address);
+	static void resize_peer_window(ENetHost* host);
+	static int wait_event(ENetHost* host, ENetEvent* evt, enet_uint32 timeout);
+	static void collect_host_totals(ENetHost* host);
 };
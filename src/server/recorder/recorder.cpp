@@ -0,0 +1,146 @@
+#include "recorder.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+
+std::vector<recorder::entry_t> recorder::entries;
+std::uint64_t recorder::head = 0;
+std::uint64_t recorder::mask = 0;
+std::uint64_t recorder::now_ns = 0;
+std::chrono::steady_clock::time_point recorder::epoch;
+std::vector<const char*> recorder::failed_invariants;
+
+void recorder::init()
+{
+	recorder::epoch = std::chrono::steady_clock::now();
+
+	if (config::recorder_events <= 0)
+	{
+		return;
+	}
+
+	// Round up to a power of two so the ring index is a mask
+	std::uint64_t size = 1;
+
+	while (size < (std::uint64_t)config::recorder_events)
+	{
+		size <<= 1;
+	}
+
+	recorder::entries.resize(size);
+	recorder::mask = size - 1;
+
+	SetUnhandledExceptionFilter(recorder::on_crash);
+	std::set_terminate(recorder::on_terminate);
+	SetConsoleCtrlHandler(recorder::on_console, TRUE);
+
+	PRINT_INFO("Flight recorder keeping the last %u events, press Ctrl+Break to dump", (unsigned)size);
+}
+
+void recorder::dump(const char* reason)
+{
+	if (recorder::entries.empty())
+	{
+		return;
+	}
+
+	auto path = FORMAT_VA("flight-recorder-%llu.log", (unsigned long long)std::time(nullptr));
+	auto file = std::fopen(path.c_str(), "wb");
+
+	if (!file)
+	{
+		PRINT_ERROR("Unable to open \"%s\"", path.c_str());
+		return;
+	}
+
+	auto head = recorder::head;
+	auto size = (std::uint64_t)recorder::entries.size();
+
+	std::fprintf(file, "Flight recorder dump: %s\n", reason);
+	std::fprintf(file, "%llu events recorded, showing the last %llu\n\n", head, std::min(head, size));
+
+	for (auto i = head > size ? head - size : 0; i < head; ++i)
+	{
+		auto& entry = recorder::entries[i & recorder::mask];
+
+		std::fprintf(
+			file,
+			"%12.3f ms  %-14s host=%-5u peer=%-5u proto=%-18s room=%-4i value=%u\n",
+			entry.time_ns / 1e6,
+			recorder::get_type_name(entry.type),
+			entry.host,
+			entry.peer,
+			entry.proto == (std::int16_t)proto_t::NONE ? "-" : networking::get_proto_name((proto_t)entry.proto),
+			entry.room,
+			entry.value
+		);
+	}
+
+	std::fclose(file);
+
+	PRINT_WARNING("Flight recorder dumped to \"%s\" (%s)", path.c_str(), reason);
+}
+
+bool recorder::check(bool condition, const char* invariant, ENetPeer* peer, proto_t proto)
+{
+	if (condition)
+	{
+		return true;
+	}
+
+	recorder::record(recorder_event_t::INVARIANT, peer, proto);
+	PRINT_ERROR("Invariant failed: %s", invariant);
+
+	if (std::find(recorder::failed_invariants.begin(), recorder::failed_invariants.end(), invariant) == recorder::failed_invariants.end())
+	{
+		recorder::failed_invariants.emplace_back(invariant);
+		recorder::dump(invariant);
+	}
+
+	return false;
+}
+
+const char* recorder::get_type_name(recorder_event_t type)
+{
+	switch (type)
+	{
+		case recorder_event_t::CONNECT: return "CONNECT";
+		case recorder_event_t::DISCONNECT: return "DISCONNECT";
+		case recorder_event_t::RECEIVE: return "RECEIVE";
+		case recorder_event_t::PARSE_FAILURE: return "PARSE_FAILURE";
+		case recorder_event_t::HANDLE: return "HANDLE";
+		case recorder_event_t::SEND: return "SEND";
+		case recorder_event_t::ROOM_CREATED: return "ROOM_CREATED";
+		case recorder_event_t::ROOM_DELETED: return "ROOM_DELETED";
+		case recorder_event_t::JOIN: return "JOIN";
+		case recorder_event_t::LEAVE: return "LEAVE";
+		case recorder_event_t::MATCH_START: return "MATCH_START";
+		case recorder_event_t::WINNER: return "WINNER";
+		case recorder_event_t::INVARIANT: return "INVARIANT";
+		case recorder_event_t::RATE_LIMITED: return "RATE_LIMITED";
+	}
+
+	return "UNKNOWN";
+}
+
+LONG WINAPI recorder::on_crash(EXCEPTION_POINTERS* exception)
+{
+	recorder::dump("unhandled exception");
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+void recorder::on_terminate()
+{
+	recorder::dump("std::terminate");
+	std::abort();
+}
+
+BOOL WINAPI recorder::on_console(DWORD type)
+{
+	if (type == CTRL_BREAK_EVENT)
+	{
+		recorder::dump("requested from console");
+		return TRUE;
+	}
+
+	return FALSE;
+}
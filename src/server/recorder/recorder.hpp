@@ -0,0 +1,82 @@
+#pragma once
+
+#include "networking/networking.hpp"
+
+enum class recorder_event_t : std::uint8_t
+{
+	CONNECT,
+	DISCONNECT,
+	RECEIVE,
+	PARSE_FAILURE,
+	HANDLE,
+	SEND,
+	ROOM_CREATED,
+	ROOM_DELETED,
+	JOIN,
+	LEAVE,
+	MATCH_START,
+	WINNER,
+	INVARIANT,
+	RATE_LIMITED,
+};
+
+// Last N events kept in a fixed ring so a bad state can be explained after the fact.
+// Recording is a handful of stores into a preallocated slot, timestamps come from stamp()
+// which is taken once per dispatched event rather than per record
+class recorder final
+{
+public:
+	struct entry_t
+	{
+		std::uint64_t time_ns;
+		recorder_event_t type;
+		std::uint8_t reserved;
+		std::int16_t proto;
+		std::uint16_t peer;
+		std::uint16_t host;
+		std::int32_t room;
+		std::uint32_t value;
+	};
+
+	static void init();
+	static void dump(const char* reason);
+
+	static void stamp()
+	{
+		recorder::now_ns = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - recorder::epoch).count();
+	}
+
+	static void record(recorder_event_t type, ENetPeer* peer = nullptr, proto_t proto = proto_t::NONE, int room = -1, std::uint32_t value = 0)
+	{
+		if (recorder::entries.empty())
+		{
+			return;
+		}
+
+		auto& entry = recorder::entries[recorder::head++ & recorder::mask];
+		entry.time_ns = recorder::now_ns;
+		entry.type = type;
+		entry.proto = (std::int16_t)proto;
+		entry.peer = peer ? peer->incomingPeerID : 0xFFFF;
+		entry.host = peer ? networking::get_host_index(peer->host) : 0xFFFF;
+		entry.room = room;
+		entry.value = value;
+	}
+
+	// Records and dumps the first failure of each invariant, returns the condition so callers can bail out
+	static bool check(bool condition, const char* invariant, ENetPeer* peer = nullptr, proto_t proto = proto_t::NONE);
+
+private:
+	static const char* get_type_name(recorder_event_t type);
+
+	static LONG WINAPI on_crash(EXCEPTION_POINTERS* exception);
+	static void on_terminate();
+	static BOOL WINAPI on_console(DWORD type);
+
+	static std::vector<entry_t> entries;
+	static std::uint64_t head;
+	static std::uint64_t mask;
+	static std::uint64_t now_ns;
+	static std::chrono::steady_clock::time_point epoch;
+	static std::vector<const char*> failed_invariants;
+};
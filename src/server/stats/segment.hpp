@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// Layout of the shared statistics segment, shared with the stats-reader tool.
+// Bump layout_version whenever a field moves
+struct stats_segment_t
+{
+	static constexpr std::uint32_t magic_value = 0x53474550; // "PEGS"
+	static constexpr std::uint32_t layout_version = 1;
+	static constexpr int proto_slots = 32;
+	static constexpr int proto_name_size = 24;
+
+	struct counters_t
+	{
+		std::uint64_t publishes;
+		std::uint64_t rooms;
+		std::uint64_t players;
+		std::uint64_t matches;
+		std::uint64_t connected_peers;
+
+		std::uint64_t bytes_sent;
+		std::uint64_t bytes_received;
+		std::uint64_t packets_sent;
+		std::uint64_t packets_received;
+
+		std::uint64_t ticks;
+		std::uint64_t tick_last_ns;
+		std::uint64_t tick_max_ns;
+		std::uint64_t tick_total_ns;
+
+		std::uint64_t heap_bytes;
+		std::uint64_t heap_allocations;
+
+		std::uint64_t messages[proto_slots];
+	};
+
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t process_id;
+	std::uint32_t port;
+	char proto_names[proto_slots][proto_name_size];
+
+	// Seqlock: odd while the server is writing, readers retry until they see the same even value on both sides of their copy
+	std::atomic<std::uint32_t> sequence;
+	counters_t counters;
+};
+
+inline void stats_segment_name(char* buffer, std::size_t size, unsigned int port)
+{
+	std::snprintf(buffer, size, "Local\\PegRoyaleStats-%u", port);
+}
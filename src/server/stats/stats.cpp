@@ -0,0 +1,163 @@
+#include "stats.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "networking/networking.hpp"
+
+ENetCallbacks stats::callbacks = { stats::enet_malloc, stats::enet_free, nullptr };
+HANDLE stats::mapping;
+stats_segment_t* stats::segment;
+std::uint64_t stats::heap_bytes = 0;
+std::uint64_t stats::heap_allocations = 0;
+
+namespace
+{
+	// Keeps the user pointer aligned the way malloc would have
+	constexpr std::size_t allocation_header = alignof(std::max_align_t);
+}
+
+void stats::init()
+{
+	if (!config::stats_segment)
+	{
+		return;
+	}
+
+	char name[64];
+	stats_segment_name(name, sizeof(name), config::port);
+
+	stats::mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(stats_segment_t), name);
+
+	if (!stats::mapping)
+	{
+		PRINT_ERROR("Unable to create stats segment \"%s\"", name);
+		return;
+	}
+
+	stats::segment = (stats_segment_t*)MapViewOfFile(stats::mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(stats_segment_t));
+
+	if (!stats::segment)
+	{
+		PRINT_ERROR("Unable to map stats segment \"%s\"", name);
+		CloseHandle(stats::mapping);
+		stats::mapping = nullptr;
+		return;
+	}
+
+	std::memset(stats::segment, 0, sizeof(stats_segment_t));
+	stats::segment->version = stats_segment_t::layout_version;
+	stats::segment->process_id = GetCurrentProcessId();
+	stats::segment->port = config::port;
+
+	for (auto i = 0; i < stats_segment_t::proto_slots; ++i)
+	{
+		std::snprintf(stats::segment->proto_names[i], stats_segment_t::proto_name_size, "%s", i ? networking::get_proto_name((proto_t)(i - 1)) : "UNKNOWN");
+	}
+
+	// Readers check the magic last so they never see a half initialised header
+	std::atomic_thread_fence(std::memory_order_release);
+	stats::segment->magic = stats_segment_t::magic_value;
+
+	PRINT_INFO("Publishing stats to \"%s\"", name);
+}
+
+void stats::publish()
+{
+	if (!stats::segment)
+	{
+		return;
+	}
+
+	auto& counters = stats::segment->counters;
+	auto sequence = stats::segment->sequence.load(std::memory_order_relaxed);
+
+	stats::segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	++counters.publishes;
+	counters.rooms = networking::rooms.size();
+	counters.players = 0;
+	counters.matches = 0;
+
+	for (auto& room : networking::rooms)
+	{
+		counters.players += room.players.size();
+		counters.matches += room.playing;
+	}
+
+	counters.connected_peers = 0;
+
+	for (auto host : networking::hosts)
+	{
+		counters.connected_peers += host->connectedPeers;
+	}
+
+	counters.bytes_sent = networking::bytes_sent;
+	counters.bytes_received = networking::bytes_received;
+	counters.packets_sent = networking::packets_sent;
+	counters.packets_received = networking::packets_received;
+
+	if (networking::tick_ns)
+	{
+		++counters.ticks;
+		counters.tick_last_ns = networking::tick_ns;
+		counters.tick_max_ns = std::max(counters.tick_max_ns, networking::tick_ns);
+		counters.tick_total_ns += networking::tick_ns;
+	}
+
+	counters.heap_bytes = stats::heap_bytes;
+	counters.heap_allocations = stats::heap_allocations;
+
+	for (auto i = 0; i < stats_segment_t::proto_slots; ++i)
+	{
+		counters.messages[i] = metrics::local_message_count(i);
+	}
+
+	stats::segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void stats::cleanup()
+{
+	if (stats::segment)
+	{
+		UnmapViewOfFile(stats::segment);
+		stats::segment = nullptr;
+	}
+
+	if (stats::mapping)
+	{
+		CloseHandle(stats::mapping);
+		stats::mapping = nullptr;
+	}
+}
+
+void* ENET_CALLBACK stats::enet_malloc(size_t size)
+{
+	auto memory = (char*)std::malloc(size + allocation_header);
+
+	if (!memory)
+	{
+		return nullptr;
+	}
+
+	*(size_t*)memory = size;
+	stats::heap_bytes += size;
+	++stats::heap_allocations;
+
+	return memory + allocation_header;
+}
+
+void ENET_CALLBACK stats::enet_free(void* memory)
+{
+	if (!memory)
+	{
+		return;
+	}
+
+	auto block = (char*)memory - allocation_header;
+
+	stats::heap_bytes -= *(size_t*)block;
+	--stats::heap_allocations;
+
+	std::free(block);
+}
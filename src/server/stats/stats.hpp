@@ -0,0 +1,23 @@
+#pragma once
+
+#include "segment.hpp"
+
+class stats final
+{
+public:
+	static void init();
+	static void publish();
+	static void cleanup();
+
+	// Counts every allocation ENet makes, handed to enet_initialize_with_callbacks
+	static ENetCallbacks callbacks;
+
+private:
+	static void* ENET_CALLBACK enet_malloc(size_t size);
+	static void ENET_CALLBACK enet_free(void* memory);
+
+	static HANDLE mapping;
+	static stats_segment_t* segment;
+	static std::uint64_t heap_bytes;
+	static std::uint64_t heap_allocations;
+};
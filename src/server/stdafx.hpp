@@ -3,9 +3,19 @@
 //System
 #include <cstdio>
 #include <cstdint>
+#include <cstddef>
 #include <string>
 #include <iostream>
 #include <random>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <set>
+#include <unordered_map>
 
 using namespace std::literals;
 
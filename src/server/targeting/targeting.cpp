@@ -0,0 +1,299 @@
+#include "targeting.hpp"
+#include "logger/logger.hpp"
+#include "networking/networking.hpp"
+
+void targeting::handle(ENetPeer* peer, int room, const std::vector<std::string>& split_packet)
+{
+	auto powerup = -1;
+	std::string attacking, mode_name;
+
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		auto& field = split_packet[i];
+
+		if (field.rfind("powerup=", 0) == 0)
+		{
+			powerup = std::atoi(field.c_str() + 8);
+		}
+		else if (field.rfind("attacking=", 0) == 0)
+		{
+			attacking = field.substr(10);
+		}
+		else if (field.rfind("mode=", 0) == 0)
+		{
+			mode_name = field.substr(5);
+		}
+	}
+
+	// Older clients only ever name their target
+	auto mode = mode_name.empty() ? target_mode_t::EXPLICIT : targeting::get_mode(mode_name);
+
+	if (powerup == -1 || (mode == target_mode_t::EXPLICIT && attacking.empty()))
+	{
+		PRINT_ERROR("Recieved malformed powerup request!");
+		return;
+	}
+
+	auto player = targeting::get_player(peer);
+	auto target = targeting::find_target(room, player, mode, attacking);
+
+	if (target == -1)
+	{
+		PRINT_DEBUG("No target for powerup %i from \"%s\"", powerup, networking::rooms[room].players[player].name.c_str());
+		return;
+	}
+
+	auto& players = networking::rooms[room].players;
+	targeting::set_target(room, player, players[target].peer);
+
+	networking::send_packet(proto_t::USE_POWEWRUP, players[target].peer, FORMAT_VA("powerup=%i;user=%s;", powerup, players[player].name.c_str()));
+
+	// Whoever let the server choose needs to be told who it picked
+	if (mode != target_mode_t::EXPLICIT)
+	{
+		networking::send_packet(proto_t::USE_POWEWRUP, peer, FORMAT_VA("powerup=%i;target=%s;", powerup, players[target].name.c_str()));
+	}
+}
+
+void targeting::handle_score(ENetPeer* peer, int room, const std::vector<std::string>& split_packet)
+{
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		if (split_packet[i].rfind("score=", 0) != 0)
+		{
+			continue;
+		}
+
+		auto& targets = networking::rooms[room].players[targeting::get_player(peer)].targets;
+		auto score = std::atoi(split_packet[i].c_str() + 6);
+
+		if (targets.alive_slot != -1 && score != targets.score)
+		{
+			auto& by_score = networking::rooms[room].targets.by_score;
+			by_score.erase({ targets.score, peer });
+			by_score.emplace(score, peer);
+		}
+
+		targets.score = score;
+		return;
+	}
+
+	PRINT_ERROR("Recieved malformed score update!");
+}
+
+void targeting::remove_player(int room, int player)
+{
+	auto& entry = networking::rooms[room];
+	auto& targets = entry.players[player].targets;
+
+	targeting::drop_alive(room, player);
+	targeting::set_target(room, player, nullptr);
+
+	for (auto attacker : targets.attackers)
+	{
+		auto& links = entry.players[targeting::get_player(attacker)].targets;
+		links.target = nullptr;
+		links.target_slot = -1;
+	}
+
+	targets.attackers.clear();
+}
+
+void targeting::start_match(int room)
+{
+	auto& entry = networking::rooms[room];
+	entry.targets.alive.clear();
+	entry.targets.by_score.clear();
+
+	for (auto& player : entry.players)
+	{
+		player.targets.score = 0;
+		player.targets.alive_slot = (int)entry.targets.alive.size();
+		player.targets.target = nullptr;
+		player.targets.target_slot = -1;
+		player.targets.attackers.clear();
+
+		entry.targets.alive.emplace_back(player.peer);
+		entry.targets.by_score.emplace(0, player.peer);
+	}
+}
+
+void targeting::end_match(int room)
+{
+	auto& entry = networking::rooms[room];
+
+	for (auto peer : entry.targets.alive)
+	{
+		entry.players[targeting::get_player(peer)].targets.alive_slot = -1;
+	}
+
+	entry.targets.alive.clear();
+	entry.targets.by_score.clear();
+}
+
+void targeting::eliminate(int room, int player)
+{
+	// Whoever is still aiming at the player gets a new target with their next powerup
+	targeting::drop_alive(room, player);
+	targeting::set_target(room, player, nullptr);
+}
+
+target_mode_t targeting::get_mode(const std::string& name)
+{
+	if (name == "random") return target_mode_t::RANDOM;
+	if (name == "weakest") return target_mode_t::WEAKEST;
+	if (name == "attackers") return target_mode_t::ATTACKERS;
+	if (name == "leader") return target_mode_t::LEADER;
+
+	return target_mode_t::EXPLICIT;
+}
+
+int targeting::find_target(int room, int player, target_mode_t mode, const std::string& name)
+{
+	auto& entry = networking::rooms[room];
+
+	switch (mode)
+	{
+		case target_mode_t::EXPLICIT:
+		{
+			auto found = entry.names.find(name);
+
+			if (found == entry.names.end() || found->second == entry.players[player].peer)
+			{
+				return -1;
+			}
+
+			return targeting::get_player(found->second);
+		}
+
+		case target_mode_t::WEAKEST:
+			return targeting::pick_by_score(room, player, false);
+
+		case target_mode_t::LEADER:
+			return targeting::pick_by_score(room, player, true);
+
+		case target_mode_t::ATTACKERS:
+		{
+			auto& attackers = entry.players[player].targets.attackers;
+
+			// Nobody is after the player, so anyone will do
+			if (attackers.empty())
+			{
+				return targeting::pick_alive(room, player);
+			}
+
+			auto pick = std::uniform_int_distribution<std::size_t>(0, attackers.size() - 1)(networking::rng);
+			return targeting::get_player(attackers[pick]);
+		}
+	}
+
+	return targeting::pick_alive(room, player);
+}
+
+int targeting::get_player(ENetPeer* peer)
+{
+	return networking::get_state(peer)->player;
+}
+
+int targeting::pick_alive(int room, int player)
+{
+	auto& alive = networking::rooms[room].targets.alive;
+	auto self = networking::rooms[room].players[player].targets.alive_slot;
+	auto count = alive.size() - (self != -1);
+
+	if (!count)
+	{
+		return -1;
+	}
+
+	// Draw from everyone but the player, whose slot stands in for the last one
+	auto pick = std::uniform_int_distribution<std::size_t>(0, count - 1)(networking::rng);
+
+	if (self != -1 && pick == (std::size_t)self)
+	{
+		pick = alive.size() - 1;
+	}
+
+	return targeting::get_player(alive[pick]);
+}
+
+int targeting::pick_by_score(int room, int player, bool highest)
+{
+	auto& by_score = networking::rooms[room].targets.by_score;
+	auto peer = networking::rooms[room].players[player].peer;
+
+	// The player can only be the first entry looked at, so at most one is skipped
+	if (highest)
+	{
+		for (auto it = by_score.rbegin(); it != by_score.rend(); ++it)
+		{
+			if (it->second != peer)
+			{
+				return targeting::get_player(it->second);
+			}
+		}
+	}
+	else
+	{
+		for (auto it = by_score.begin(); it != by_score.end(); ++it)
+		{
+			if (it->second != peer)
+			{
+				return targeting::get_player(it->second);
+			}
+		}
+	}
+
+	return -1;
+}
+
+void targeting::set_target(int room, int player, ENetPeer* target)
+{
+	auto& players = networking::rooms[room].players;
+	auto& targets = players[player].targets;
+
+	if (targets.target == target)
+	{
+		return;
+	}
+
+	if (targets.target)
+	{
+		// Swap with the last attacker so removal never shifts the rest
+		auto& attackers = players[targeting::get_player(targets.target)].targets.attackers;
+		auto moved = attackers.back();
+		attackers[targets.target_slot] = moved;
+		players[targeting::get_player(moved)].targets.target_slot = targets.target_slot;
+		attackers.pop_back();
+	}
+
+	targets.target = target;
+	targets.target_slot = -1;
+
+	if (target)
+	{
+		auto& attackers = players[targeting::get_player(target)].targets.attackers;
+		targets.target_slot = (int)attackers.size();
+		attackers.emplace_back(players[player].peer);
+	}
+}
+
+void targeting::drop_alive(int room, int player)
+{
+	auto& entry = networking::rooms[room];
+	auto& targets = entry.players[player].targets;
+
+	if (targets.alive_slot == -1)
+	{
+		return;
+	}
+
+	auto& alive = entry.targets.alive;
+	auto moved = alive.back();
+	alive[targets.alive_slot] = moved;
+	entry.players[targeting::get_player(moved)].targets.alive_slot = targets.alive_slot;
+	alive.pop_back();
+
+	entry.targets.by_score.erase({ targets.score, entry.players[player].peer });
+	targets.alive_slot = -1;
+}
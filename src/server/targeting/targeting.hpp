@@ -0,0 +1,64 @@
+#pragma once
+
+enum class target_mode_t
+{
+	EXPLICIT,
+	RANDOM,
+	WEAKEST,
+	ATTACKERS,
+	LEADER,
+};
+
+// What a player is aiming at and who is aiming at them. Links name peers rather than roster slots,
+// so the last player moving into a leaver's slot leaves every link valid
+struct player_targets_t
+{
+	int score = 0;
+
+	// Position in the room's alive list, -1 once out of the match
+	int alive_slot = -1;
+
+	// Who this player last hit, and where they sit in that player's attackers
+	ENetPeer* target = nullptr;
+	int target_slot = -1;
+
+	std::vector<ENetPeer*> attackers;
+};
+
+// Indexes a room keeps up to date as players join, leave, score and die, so picking a target never scans the roster
+struct room_targets_t
+{
+	// Players still in the current match, unordered for constant time picks and removal
+	std::vector<ENetPeer*> alive;
+
+	// The same players ordered by their last reported score, ties broken by peer
+	std::set<std::pair<int, ENetPeer*>> by_score;
+};
+
+// Resolves the target of a powerup on the server. A client names a player outright or asks for a mode:
+// anyone still alive, the lowest or highest score, or one of the players currently attacking them
+class targeting final
+{
+public:
+	static void handle(ENetPeer* peer, int room, const std::vector<std::string>& split_packet);
+	static void handle_score(ENetPeer* peer, int room, const std::vector<std::string>& split_packet);
+
+	// Call before the player is taken off the roster
+	static void remove_player(int room, int player);
+
+	static void start_match(int room);
+	static void end_match(int room);
+	static void eliminate(int room, int player);
+
+	static target_mode_t get_mode(const std::string& name);
+
+	// Roster index of the player hit, or -1 when nobody fits
+	static int find_target(int room, int player, target_mode_t mode, const std::string& name);
+
+private:
+	static int get_player(ENetPeer* peer);
+	static int pick_alive(int room, int player);
+	static int pick_by_score(int room, int player, bool highest);
+	static void set_target(int room, int player, ENetPeer* target);
+	static void drop_alive(int room, int player);
+};
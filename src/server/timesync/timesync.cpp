@@ -0,0 +1,142 @@
+#include "timesync.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+#include "metrics/metrics.hpp"
+#include "networking/networking.hpp"
+
+std::chrono::steady_clock::time_point timesync::epoch;
+
+void timesync::init()
+{
+	timesync::epoch = std::chrono::steady_clock::now();
+}
+
+std::uint64_t timesync::now_ms()
+{
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(networking::event_time - timesync::epoch).count();
+}
+
+void timesync::handle(ENetPeer* peer, const std::vector<std::string>& split_packet)
+{
+	auto received = timesync::now_ms();
+	std::string client_time = "0";
+
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		if (split_packet[i].rfind("t0=", 0) == 0)
+		{
+			client_time = split_packet[i].substr(3);
+		}
+	}
+
+	// A retransmitted reply carries stale times, losing one just means the client asks again
+	auto sent = (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timesync::epoch).count();
+
+	networking::send_packet(
+		proto_t::CLOCK_SYNC,
+		peer,
+		FORMAT_VA("t0=%s;t1=%llu;t2=%llu;rtt=%u;", client_time.c_str(), (unsigned long long)received, (unsigned long long)sent, (unsigned)peer->roundTripTime),
+		0
+	);
+}
+
+std::uint64_t timesync::schedule_start(int room)
+{
+	enet_uint32 slowest = 0;
+
+	for (auto& player : networking::rooms[room].players)
+	{
+		if (player.peer)
+		{
+			slowest = std::max(slowest, player.peer->roundTripTime + 2 * player.peer->roundTripTimeVariance);
+		}
+	}
+
+	// A full round trip of headroom covers the one way trip plus one retransmit on a typical link
+	return timesync::now_ms() + std::max<std::uint64_t>(config::start_lead, slowest);
+}
+
+void timesync::open_report(int room, std::uint64_t start_at)
+{
+	auto& entry = networking::rooms[room];
+	entry.start_report = start_report_t{ true, start_at };
+
+	for (auto& player : entry.players)
+	{
+		player.started = false;
+	}
+}
+
+void timesync::handle_start(ENetPeer* peer, int room, const std::vector<std::string>& split_packet)
+{
+	auto started = -1.0;
+
+	for (auto i = 1u; i < split_packet.size(); ++i)
+	{
+		if (split_packet[i].rfind("started=", 0) == 0)
+		{
+			started = std::strtod(split_packet[i].c_str() + 8, nullptr);
+		}
+	}
+
+	if (started < 0.0)
+	{
+		PRINT_ERROR("Recieved malformed start acknowledgement!");
+		return;
+	}
+
+	auto& entry = networking::rooms[room];
+	auto& player = entry.players[networking::get_user_index(peer, room)];
+	auto& report = entry.start_report;
+
+	if (!report.open || player.started)
+	{
+		return;
+	}
+
+	// A client that never synced its clock can be off by anything, keep it out of the spread
+	if (std::abs(started - (double)report.start_at) > 10000.0)
+	{
+		PRINT_WARNING("Player \"%s\" reported starting %.0f ms away from the scheduled start", player.name.c_str(), started - (double)report.start_at);
+		return;
+	}
+
+	player.started = true;
+	report.earliest = report.acks ? std::min(report.earliest, started) : started;
+	report.latest = report.acks ? std::max(report.latest, started) : started;
+
+	if (++report.acks == (int)entry.players.size())
+	{
+		timesync::close_report(room);
+	}
+}
+
+void timesync::close_report(int room)
+{
+	auto& entry = networking::rooms[room];
+	auto& report = entry.start_report;
+
+	if (!report.open)
+	{
+		return;
+	}
+
+	report.open = false;
+
+	// Clients that do not acknowledge leave nothing to compare
+	if (report.acks < 2)
+	{
+		return;
+	}
+
+	metrics::record_start_skew((std::uint64_t)((report.latest - report.earliest) * 1000000.0));
+
+	PRINT_INFO(
+		"Room \"%s\" started within %.1f ms, last player %.1f ms after start_at (%i of %i reported)",
+		entry.id.c_str(),
+		report.latest - report.earliest,
+		report.latest - (double)report.start_at,
+		report.acks,
+		(int)entry.players.size()
+	);
+}
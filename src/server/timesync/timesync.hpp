@@ -0,0 +1,38 @@
+#pragma once
+
+// When the players of the current match say they actually started, in server milliseconds
+struct start_report_t
+{
+	bool open = false;
+	std::uint64_t start_at = 0;
+	double earliest = 0.0;
+	double latest = 0.0;
+	int acks = 0;
+};
+
+// NTP style exchange over the game connection. A client sends CLOCK_SYNC with its own send time,
+// the reply echoes it with the server's receive and send times plus ENet's smoothed RTT, so the
+// client can work out its offset to server time and throw away samples that took a slow path.
+// Once started, a synced client answers START_ACK with the server time it started at, and the spread
+// of those answers is the start skew players actually saw
+class timesync final
+{
+public:
+	static void init();
+
+	// Milliseconds on the server's monotonic clock, the time base start_at is given in
+	static std::uint64_t now_ms();
+
+	static void handle(ENetPeer* peer, const std::vector<std::string>& split_packet);
+
+	// Picks a start far enough ahead that the start message reaches every player before it
+	static std::uint64_t schedule_start(int room);
+
+	// Starts collecting START_ACKs for a match, the report closes once every player answered or the match ends
+	static void open_report(int room, std::uint64_t start_at);
+	static void handle_start(ENetPeer* peer, int room, const std::vector<std::string>& split_packet);
+	static void close_report(int room);
+
+private:
+	static std::chrono::steady_clock::time_point epoch;
+};
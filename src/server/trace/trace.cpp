@@ -0,0 +1,96 @@
+#include "trace.hpp"
+#include "logger/logger.hpp"
+#include "config/config.hpp"
+
+bool trace::enabled = false;
+std::mutex trace::registry_mutex;
+std::vector<std::unique_ptr<trace::ring_t>> trace::registry;
+std::chrono::steady_clock::time_point trace::epoch;
+
+void trace::init()
+{
+	trace::epoch = std::chrono::steady_clock::now();
+	trace::enabled = config::trace != 0;
+
+	if (trace::enabled)
+	{
+		PRINT_INFO("Tracing enabled, keeping the last %i spans per thread", config::trace_buffer);
+	}
+}
+
+void trace::flush()
+{
+	if (!trace::enabled)
+	{
+		return;
+	}
+
+	auto file = std::fopen("trace.json", "wb");
+
+	if (!file)
+	{
+		PRINT_ERROR("Unable to open trace.json");
+		return;
+	}
+
+	std::fprintf(file, "{\"traceEvents\":[\n");
+
+	auto first = true;
+	std::lock_guard<std::mutex> lock(trace::registry_mutex);
+
+	for (auto& ring : trace::registry)
+	{
+		auto head = ring->head.load(std::memory_order_acquire);
+		auto size = (std::uint64_t)ring->events.size();
+
+		for (auto i = head > size ? head - size : 0; i < head; ++i)
+		{
+			auto& event = ring->events[i % size];
+			auto ts = std::chrono::duration<double, std::micro>(event.start - trace::epoch).count();
+			auto dur = std::chrono::duration<double, std::micro>(event.end - event.start).count();
+
+			std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", first ? "" : ",\n", event.name, ring->thread_id, ts, dur);
+
+			if (event.detail)
+			{
+				std::fprintf(file, ",\"args\":{\"detail\":\"%s\"}", event.detail);
+			}
+
+			std::fprintf(file, "}");
+			first = false;
+		}
+	}
+
+	std::fprintf(file, "\n]}\n");
+	std::fclose(file);
+
+	PRINT_INFO("Trace written to trace.json");
+}
+
+void trace::record(const char* name, const char* detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	auto& ring = trace::local();
+	auto head = ring.head.load(std::memory_order_relaxed);
+
+	ring.events[head % ring.events.size()] = { name, detail, start, end };
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+trace::ring_t& trace::local()
+{
+	thread_local ring_t* ring = nullptr;
+
+	if (!ring)
+	{
+		std::lock_guard<std::mutex> lock(trace::registry_mutex);
+
+		auto new_ring = std::make_unique<ring_t>();
+		new_ring->thread_id = (std::uint32_t)trace::registry.size() + 1;
+		new_ring->events.resize(std::max(config::trace_buffer, 1));
+
+		ring = new_ring.get();
+		trace::registry.emplace_back(std::move(new_ring));
+	}
+
+	return *ring;
+}
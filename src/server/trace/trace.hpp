@@ -0,0 +1,69 @@
+#pragma once
+
+#define TRACE_CONCAT_IMPL(__A__, __B__) __A__##__B__
+#define TRACE_CONCAT(__A__, __B__) TRACE_CONCAT_IMPL(__A__, __B__)
+
+// Records a Chrome trace span covering the rest of the enclosing block
+#define TRACE_SCOPE(__NAME__, ...) trace::span TRACE_CONCAT(trace_span_, __LINE__)(__NAME__, __VA_ARGS__)
+
+class trace final
+{
+public:
+	class span final
+	{
+	public:
+		span(const char* name, const char* detail = nullptr)
+		{
+			if (!trace::enabled)
+			{
+				return;
+			}
+
+			this->name = name;
+			this->detail = detail;
+			this->start = std::chrono::steady_clock::now();
+		}
+
+		~span()
+		{
+			if (this->name)
+			{
+				trace::record(this->name, this->detail, this->start, std::chrono::steady_clock::now());
+			}
+		}
+
+	private:
+		const char* name = nullptr;
+		const char* detail = nullptr;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static void init();
+	static void flush();
+
+	static bool enabled;
+
+private:
+	struct event_t
+	{
+		const char* name;
+		const char* detail;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point end;
+	};
+
+	// Fixed size per thread, the oldest spans are overwritten once it wraps
+	struct ring_t
+	{
+		std::uint32_t thread_id;
+		std::vector<event_t> events;
+		std::atomic<std::uint64_t> head{};
+	};
+
+	static void record(const char* name, const char* detail, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	static ring_t& local();
+
+	static std::mutex registry_mutex;
+	static std::vector<std::unique_ptr<ring_t>> registry;
+	static std::chrono::steady_clock::time_point epoch;
+};
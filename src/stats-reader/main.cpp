@@ -0,0 +1,109 @@
+#include "stats/segment.hpp"
+
+bool read_counters(const stats_segment_t* segment, stats_segment_t::counters_t& counters)
+{
+	for (auto attempt = 0; attempt < 1000; ++attempt)
+	{
+		auto before = segment->sequence.load(std::memory_order_acquire);
+
+		if (before & 1)
+		{
+			continue;
+		}
+
+		std::memcpy(&counters, (const void*)&segment->counters, sizeof(counters));
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (segment->sequence.load(std::memory_order_relaxed) == before)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void print_counters(const stats_segment_t* segment, const stats_segment_t::counters_t& counters)
+{
+	std::printf("---------- PegRoyale server %u (pid %u) ----------\n", segment->port, segment->process_id);
+	std::printf("rooms %llu, players %llu, matches %llu, peers %llu\n", counters.rooms, counters.players, counters.matches, counters.connected_peers);
+	std::printf("sent %llu bytes / %llu datagrams, received %llu bytes / %llu datagrams\n", counters.bytes_sent, counters.packets_sent, counters.bytes_received, counters.packets_received);
+	std::printf(
+		"ticks %llu, last %.1f us, avg %.1f us, max %.1f us\n",
+		counters.ticks,
+		counters.tick_last_ns / 1000.0,
+		counters.ticks ? counters.tick_total_ns / 1000.0 / counters.ticks : 0.0,
+		counters.tick_max_ns / 1000.0
+	);
+	std::printf("enet heap %llu bytes in %llu allocations\n", counters.heap_bytes, counters.heap_allocations);
+
+	for (auto i = 0; i < stats_segment_t::proto_slots; ++i)
+	{
+		if (counters.messages[i])
+		{
+			std::printf("  %-20s %llu\n", segment->proto_names[i], counters.messages[i]);
+		}
+	}
+
+	std::printf("\n");
+}
+
+int __cdecl main(int argc, char* argv[])
+{
+	unsigned int port = 23363;
+	int watch = 0;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "-watch" && i + 1 < argc)
+		{
+			watch = std::atoi(argv[++i]);
+		}
+		else
+		{
+			port = std::atoi(argv[i]);
+		}
+	}
+
+	char name[64];
+	stats_segment_name(name, sizeof(name), port);
+
+	auto mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+
+	if (!mapping)
+	{
+		std::printf("No stats segment \"%s\", is the server running with stats_segment=1?\n", name);
+		return 1;
+	}
+
+	auto segment = (const stats_segment_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(stats_segment_t));
+
+	if (!segment || segment->magic != stats_segment_t::magic_value || segment->version != stats_segment_t::layout_version)
+	{
+		std::printf("Stats segment \"%s\" is not readable by this version\n", name);
+		return 1;
+	}
+
+	do
+	{
+		stats_segment_t::counters_t counters;
+
+		if (read_counters(segment, counters))
+		{
+			print_counters(segment, counters);
+		}
+		else
+		{
+			std::printf("Server is updating too fast to get a consistent read\n");
+		}
+
+		if (watch > 0)
+		{
+			Sleep(watch * 1000);
+		}
+	} while (watch > 0);
+
+	UnmapViewOfFile(segment);
+	CloseHandle(mapping);
+	return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+//System
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <atomic>
+
+using namespace std::literals;
+
+#include <Windows.h>
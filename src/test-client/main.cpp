@@ -1,11 +1,12 @@
 #include "logger/logger.hpp"
 #include "global/global.hpp"
+#include "compression/codec.hpp"
 
 ENetAddress address;
 ENetHost* client;
 ENetPeer* server;
 
-void init()
+void init(const char* host, enet_uint16 port, bool compress)
 {
 	logger::init("test-client");
 
@@ -27,9 +28,15 @@ void init()
 		global::shutdown = true;
 	}
 
-	enet_address_set_host(&address, "127.0.0.1");
-	address.port = 23363;
-	server = enet_host_connect(client, &address, 2, 0);
+	// The compressed port only accepts clients that announce the same model in the connect data
+	if (compress && !codec::enable(client))
+	{
+		PRINT_ERROR("Unable to enable compression");
+	}
+
+	enet_address_set_host(&address, host);
+	address.port = port;
+	server = enet_host_connect(client, &address, 2, compress ? codec::model_version : 0);
 
 	if (!server)
 	{
@@ -51,7 +58,7 @@ void init()
 				break;
 
 			case ENET_EVENT_TYPE_DISCONNECT:
-				PRINT_INFO("Disconnect from the server");
+				PRINT_INFO("Disconnect from the server (%u)", evt.data);
 				break;
 			}
 		}
@@ -62,6 +69,18 @@ void init()
 
 int __cdecl main(int argc, char* argv[])
 {
-	init();
+	// Point at net-proxy to run through an impaired link
+	const char* host = "127.0.0.1";
+	enet_uint16 port = 23363;
+	bool compress = false;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "-compress") compress = true;
+		else if (i + 1 < argc && std::string(argv[i]) == "-host") host = argv[++i];
+		else if (i + 1 < argc && std::string(argv[i]) == "-port") port = (enet_uint16)std::atoi(argv[++i]);
+	}
+
+	init(host, port, compress);
 	return 0;
 }